@@ -0,0 +1,131 @@
+// Checks that a function call allocates nothing once the machine's stack has
+// grown: runs a naive fib at two depths, counting the heap allocations made
+// while each runs, and fails if the deeper one, which makes far more calls,
+// allocated more than the shallow one. Then checks that a call costs no more
+// the deeper it is: runs a recursion that defines a function in every call
+// and reads names its callers have no slot for, doubling the depth each step,
+// and fails if the allocations per call grew or the time per call doubled.
+#include "../src/lib/scrypt.hpp"
+#include "../src/lib/structure.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+namespace
+{
+atomic<size_t> allocations{0};
+}
+
+// This program's own operator new, which counts what it allocates.
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, memory_order_relaxed);
+    if (void *memory = malloc(size == 0 ? 1 : size))
+    {
+        return memory;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+    free(memory);
+}
+
+namespace
+{
+// What running a program cost, leaving out lexing, parsing and compiling it.
+struct Cost
+{
+    size_t allocations;
+    double seconds;
+};
+
+Cost measure(const string &source)
+{
+    SplicedTexts spliced;
+    vector<Token> tokens = readTokens(string_view(source), spliced);
+    indexStructure(source);
+    syntaxTree().reset(tokens);
+    vector<NodeIndex> trees = parseProgram(tokens);
+    Chunk program = compileProgram(trees);
+
+    size_t before = allocations;
+    auto start = chrono::steady_clock::now();
+    Machine().run(program);
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return Cost{allocations - before, elapsed.count()};
+}
+
+// The heap allocations made while running fib(n).
+size_t countRun(int n)
+{
+    Cost cost = measure("def fib(n) { if n < 2 { return n; } return fib(n - 1) + fib(n - 2); }\n"
+                        "print fib(" + to_string(n) + ");\n");
+    cout << "fib(" << n << "): " << cost.allocations << " allocations, " << cost.seconds << "s" << endl;
+    return cost.allocations;
+}
+
+// Runs a recursion depth calls deep, each call defining a function and reading
+// a global and a parameter of leaf that none of its callers has a slot for,
+// and prints and returns the allocations and nanoseconds per call of the
+// fastest of a few runs.
+pair<double, double> perCall(int depth)
+{
+    string source = "g = 1;\n"
+                    "def leaf(zz) { return zz + g; }\n"
+                    "def r(n) { def inner() { return g; } x = leaf(1); if n > 0 { return r(n - 1); } return inner(); }\n"
+                    "r(" + to_string(depth) + ");\n";
+    Cost best{0, 0};
+    for (int run = 0; run < 3; run++)
+    {
+        Cost cost = measure(source);
+        best = run == 0 ? cost : Cost{min(best.allocations, cost.allocations), min(best.seconds, cost.seconds)};
+    }
+    double allocationsPerCall = double(best.allocations) / depth;
+    double nanosecondsPerCall = best.seconds / depth * 1e9;
+    cout << "depth " << depth << ": " << allocationsPerCall << " allocations/call, " << nanosecondsPerCall
+         << " ns/call" << endl;
+    return {allocationsPerCall, nanosecondsPerCall};
+}
+}
+
+int main()
+{
+    size_t shallow = countRun(10);
+    size_t deep = countRun(25);
+    if (deep != shallow)
+    {
+        cout << "FAIL: " << deep - shallow << " more allocations for more calls" << endl;
+        return 1;
+    }
+    const int smallest = 2000;
+    const int largest = 16000;
+    pair<double, double> first = perCall(smallest);
+    pair<double, double> last = first;
+    for (int depth = smallest * 2; depth <= largest; depth *= 2)
+    {
+        last = perCall(depth);
+    }
+    bool flat = true;
+    if (last.first > first.first)
+    {
+        cout << "FAIL: more allocations per call at depth " << largest << " than at " << smallest << endl;
+        flat = false;
+    }
+    if (last.second > 2 * first.second)
+    {
+        cout << "FAIL: calls took " << last.second / first.second << " times as long at depth " << largest
+             << " as at " << smallest << endl;
+        flat = false;
+    }
+    return flat ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+// Measures how fast the lexer gets through a large generated script, in MB/s,
+// on one thread and on as many as there are cores, and fails if the two do not
+// give the same tokens.
+#include "../src/lib/lex.hpp"
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+namespace
+{
+// A script of at least size bytes in the shape of generated ones: functions
+// with nested blocks, long names, numbers, arrays and every kind of operator,
+// indented with spaces.
+string generateScript(size_t size)
+{
+    string script;
+    script.reserve(size + 1024);
+    for (int i = 0; script.size() < size; i++)
+    {
+        string n = to_string(i);
+        script += "def update_counter_" + n + "(previous_value, step) {\n";
+        script += "    result = previous_value * 1.5 + step / 3 - " + n + " % 7;\n";
+        script += "    if result >= 1000 & step != 0 | previous_value <= -2.25 {\n";
+        script += "        values = [result, step, " + n + ".125, null, true, false];\n";
+        script += "        while result > 10 {\n";
+        script += "            result = result - len(values);\n";
+        script += "        }\n";
+        script += "    }\n";
+        script += "    return result == " + n + " ^ step < 1;\n";
+        script += "}\n";
+        script += "total_" + n + " = update_counter_" + n + "(" + n + ", 2);\n";
+        script += "print total_" + n + ";\n";
+    }
+    return script;
+}
+
+// The fastest of a few runs of lexing script on threadCount threads, in MB/s,
+// leaving the tokens of the last run in tokens and their spliced texts in spliced.
+double measure(string_view script, unsigned threadCount, vector<Token> &tokens, SplicedTexts &spliced)
+{
+    double best = 0;
+    for (int run = 0; run < 3; run++)
+    {
+        spliced.clear();
+        auto start = chrono::steady_clock::now();
+        tokens = readTokensParallel(script, threadCount, spliced);
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        best = max(best, double(script.size()) / 1e6 / elapsed.count());
+    }
+    return best;
+}
+}
+
+int main()
+{
+    string script = generateScript(16 << 20);
+    unsigned cores = max(thread::hardware_concurrency(), 1u);
+
+    vector<Token> serial;
+    vector<Token> parallel;
+    SplicedTexts serialSpliced;
+    SplicedTexts parallelSpliced;
+    double serialSpeed = measure(script, 1, serial, serialSpliced);
+    double parallelSpeed = measure(script, cores, parallel, parallelSpliced);
+    cout << "lexed " << script.size() / 1e6 << " MB into " << serial.size() << " tokens" << endl;
+    cout << "1 thread: " << serialSpeed << " MB/s" << endl;
+    cout << cores << (cores == 1 ? " thread" : " threads") << " (one per core): " << parallelSpeed << " MB/s" << endl;
+
+    bool same = !serial.empty() && serial.size() == parallel.size();
+    for (size_t i = 0; same && i < serial.size(); i++)
+    {
+        same = serial[i].type == parallel[i].type && serial[i].text == parallel[i].text &&
+               serial[i].offset == parallel[i].offset;
+    }
+    if (!same)
+    {
+        cout << "FAIL: lexing on " << cores << " threads gave different tokens" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+// Measures how parse time grows with the size of a single expression, both a
+// long flat one and a deeply nested one, doubling the size each step. Parsing
+// is meant to be linear in the number of tokens, so this fails if the time per
+// token at the largest size is far above that at the smallest.
+#include "../src/lib/statements.hpp"
+#include "../src/lib/structure.hpp"
+#include <chrono>
+#include <functional>
+#include <iostream>
+
+using namespace std;
+
+namespace
+{
+// A sum of terms terms, alternating the operators and what they apply to.
+string longExpression(int terms)
+{
+    const char *operators[] = {" + ", " * ", " - ", " / ", " == ", " < "};
+    string expression = "value = 1";
+    for (int i = 1; i < terms; i++)
+    {
+        expression += operators[i % 6];
+        expression += i % 2 == 0 ? "name" : to_string(i);
+    }
+    return expression + ";\n";
+}
+
+// An expression nested depth levels deep in parentheses, call arguments and
+// array literals in turn.
+string nestedExpression(int depth)
+{
+    const char *openers[] = {"(2 * ", "f(1, ", "[1, "};
+    const char *closers[] = {")", ")", "]"};
+    string expression = "value = ";
+    for (int i = 0; i < depth; i++)
+    {
+        expression += openers[i % 3];
+    }
+    expression += "x";
+    for (int i = depth - 1; i >= 0; i--)
+    {
+        expression += closers[i % 3];
+    }
+    return expression + ";\n";
+}
+
+// The fastest of a few parses of source, in seconds, and its token count.
+double measure(const string &source, size_t &tokenCount)
+{
+    SplicedTexts spliced;
+    vector<Token> tokens = readTokens(string_view(source), spliced);
+    tokenCount = tokens.size();
+    indexStructure(source);
+    double best = 0;
+    for (int run = 0; run < 3; run++)
+    {
+        syntaxTree().reset(tokens);
+        auto start = chrono::steady_clock::now();
+        parseProgram(tokens);
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        best = run == 0 ? elapsed.count() : min(best, elapsed.count());
+    }
+    return best;
+}
+
+// Prints the parse time of make(size) at each size, doubling from smallest to
+// largest, and returns false if the time per token grew more than fourfold.
+bool scale(const string &name, const function<string(int)> &make, int smallest, int largest)
+{
+    double first = 0;
+    double last = 0;
+    for (int size = smallest; size <= largest; size *= 2)
+    {
+        size_t tokenCount;
+        double seconds = measure(make(size), tokenCount);
+        last = seconds / double(tokenCount) * 1e9;
+        first = size == smallest ? last : first;
+        cout << name << " " << size << ": " << tokenCount << " tokens, " << seconds * 1e3 << " ms, " << last
+             << " ns/token" << endl;
+    }
+    if (last > 4 * first)
+    {
+        cout << "FAIL: " << name << " expressions took " << last / first << " times as long per token at "
+             << largest << " as at " << smallest << endl;
+        return false;
+    }
+    return true;
+}
+}
+
+int main()
+{
+    bool linear = scale("long", longExpression, 1 << 12, 1 << 17);
+    // deep enough to show growth while staying clear of the stack limit
+    linear = scale("nested", nestedExpression, 1 << 7, 1 << 11) && linear;
+    return linear ? 0 : 1;
+}
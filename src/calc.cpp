@@ -1,4 +1,5 @@
 #include "lib/calc.hpp"
+#include "lib/structure.hpp"
 #include <iostream>
 #include <limits>
 #include <cmath>
@@ -7,86 +8,27 @@
 
 using namespace std;
 
-void deleteNodeCalc(Node *node)
-{
-    if (node != nullptr)
-    {
-        if (ArrayLiteralNode *aLNode = dynamic_cast<ArrayLiteralNode *>(node))
-        {
-            for (Node *child : aLNode->array)
-            {
-                deleteNodeCalc(child);
-            }
-            delete aLNode;
-        }
-        // for array assign node
-        else if (ArrayAssignNode *aANode = dynamic_cast<ArrayAssignNode *>(node))
-        {
-            deleteNodeCalc(aANode->expression);
-            deleteNodeCalc(aANode->arrayIndex);
-            delete aANode;
-        }
-        else if (ReturnNode *rNode = dynamic_cast<ReturnNode *>(node))
-        {
-            if (rNode->expression)
-            {
-                deleteNodeCalc(rNode->expression);
-            }
-            delete rNode;
-        }
-        // for function definition
-        else if (FunctDefNode *fNode = dynamic_cast<FunctDefNode *>(node))
-        {
-            for (Node *child : fNode->statements)
-            {
-                deleteNodeCalc(child);
-            }
-            delete fNode;
-        }
-        // for function call
-        else if (FunctCallNode *fNode = dynamic_cast<FunctCallNode *>(node))
-        {
-            for (Node *child : fNode->arguments)
-            {
-                deleteNodeCalc(child);
-            }
-            delete fNode;
-        }
-        else
-        {
-            for (Node *child : node->children)
-            {
-                deleteNodeCalc(child);
-            }
-            delete node;
-        }
-        
-    }
-}
-
 Node *makeNodeCalc(const Token &token)
 {
-    Node *node = new Node();
+    Node *node = nodeArena().make<Node>();
     node->token = token;
     return node;
 }
-ArrayLiteralNode *makeArrayLiteralNodeCalc(const Token &token)
+ArrayLiteralNode *makeArrayLiteralNodeCalc()
 {
-    ArrayLiteralNode *aLNode = new ArrayLiteralNode();
-    aLNode->token = token;
+    ArrayLiteralNode *aLNode = nodeArena().make<ArrayLiteralNode>();
     return aLNode;
 }
 
-ArrayAssignNode *makeArrayAssignNodeCalc(const Token &token)
+ArrayAssignNode *makeArrayAssignNodeCalc()
 {
-    ArrayAssignNode *aANode = new ArrayAssignNode();
-    aANode->token = token;
+    ArrayAssignNode *aANode = nodeArena().make<ArrayAssignNode>();
     return aANode;
 }
 
 FunctCallNode *makeFunctCallNodeCalc(const Token &token)
 {
-    FunctCallNode *fcNode = new FunctCallNode();
+    FunctCallNode *fcNode = nodeArena().make<FunctCallNode>();
     fcNode->functname = token;
     return fcNode;
 }
@@ -109,12 +51,12 @@ FunctCallNode *parseFunctCallCalc(const vector<Token> &tokens, int &index, bool
     FNode->functname = tokens[index - 1];
     // cout << "make funct call node for " << FNode->functname.text << endl;
     index++;
-    if (matchCalc(tokens, index, ","))
+    if (matchCalc(tokens, index, TokenKind::COMMA))
     {
         error = true;
         printErrorCalc(tokens[index], error);
     }
-    while (!matchCalc(tokens, index, ")"))
+    while (!matchCalc(tokens, index, TokenKind::RIGHT_PAREN))
     {
         Node *node = parseExpressionCalc(tokens, index, error);
         // cout << "node: " << node->token.text << endl;
@@ -122,15 +64,15 @@ FunctCallNode *parseFunctCallCalc(const vector<Token> &tokens, int &index, bool
         {
             FNode->arguments.push_back(node);
         }
-        if(matchCalc(tokens, index, ")")){
+        if(matchCalc(tokens, index, TokenKind::RIGHT_PAREN)){
             break;
         }
         index++;
-        // if(matchCalc(tokens, index - 1, ",")){
+        // if(matchCalc(tokens, index - 1, TokenKind::COMMA)){
         //     continue;
         // }
         // cout << "here " << tokens[index].text << endl;
-        if(matchCalc(tokens, index, ")")){
+        if(matchCalc(tokens, index, TokenKind::RIGHT_PAREN)){
             break;
         }
         index++;
@@ -157,241 +99,125 @@ Node *parseExpressionCalc(const vector<Token> &tokens, int &index, bool &error)
     bool commaCheck = false;
     bool parenCheck = false;
 
-    if (startOfExpression > 0 && (matchCalc(tokens, startOfExpression - 1, "while") 
-        || matchCalc(tokens, startOfExpression - 1, "if") || matchCalc(tokens, startOfExpression - 1, "def")))
+    if (startOfExpression > 0 && (matchCalc(tokens, startOfExpression - 1, TokenKind::KW_WHILE) 
+        || matchCalc(tokens, startOfExpression - 1, TokenKind::KW_IF) || matchCalc(tokens, startOfExpression - 1, TokenKind::KW_DEF)))
     {
         braceCheck = true;
     }
-    if (startOfExpression > 0 && matchCalc(tokens, startOfExpression - 1, "["))
+    if (startOfExpression > 0 && matchCalc(tokens, startOfExpression - 1, TokenKind::LEFT_BRACKET))
     {
         bracketCheck = true;
     }
-    if (startOfExpression > 0 && matchCalc(tokens, startOfExpression - 1, ","))
+    if (startOfExpression > 0 && matchCalc(tokens, startOfExpression - 1, TokenKind::COMMA))
     {
         commaCheck = true;
     }
-    if (startOfExpression > 1 && matchCalc(tokens, startOfExpression - 1, "(") && tokens[startOfExpression - 2].type == IDENTIFIER) 
+    if (startOfExpression > 1 && matchCalc(tokens, startOfExpression - 1, TokenKind::LEFT_PAREN) && tokens[startOfExpression - 2].type == IDENTIFIER) 
     {
         parenCheck = true;
     }
-    int nested = 0;
-    // Iterate through the tokens to build the expression
-    for (size_t x = startOfExpression; x < tokens.size() - 1; x++)
-    {
-        Token currToken = tokens[x];
-        Token nextToken = tokens[x + 1];
-        tokensExpression.push_back(currToken);
-        if (braceCheck)
-        {
-            if (nextToken.type == LEFT_BRACE)
-            {
-                index = x;
-                break;
-            }
-        }
-        else if (bracketCheck || commaCheck || parenCheck)
-        {
-            if (currToken.type == LEFT_PAREN || currToken.type == LEFT_BRACKET)
-            {
-                nested++;
-            }
-            if (nested == 0 && (nextToken.type == RIGHT_BRACKET || nextToken.type == COMMA || nextToken.type == RIGHT_PAREN))
-            {
-                index = x;
-                break;
-            }
-            if (nextToken.type == RIGHT_PAREN || nextToken.type == RIGHT_BRACKET)
-            {
-                nested--;
-            }
-        }
-        else if (matchCalc(tokens, startOfExpression, "["))
-        {
-            if (currToken.type == SEMICOLON)
-            {
-                index = x;
-                break;
-            }
-        }
-        else
-        {
-            if (currToken.length != nextToken.lineNumber  || nextToken.type == END || currToken.text == ";")
-            {
-                index = x;
-                break;
-            }
-        }
-    }
-    int assignIndex = 0;
-    return parseAssignmentCalc(tokensExpression, assignIndex, error);
-}
-
-// Function to parse assignment expressions
-Node *parseAssignmentCalc(const vector<Token> &tokens, int &index, bool &error)
-{
-    if (error)
-    {
-        return nullptr;
-    }
-    Node *left = parseLogicOrCalc(tokens, index, error);
-    if (matchCalc(tokens, index, "="))
-    {
-        Node *assignNode = makeNodeCalc(tokens[index]);
-        Node *right = parseAssignmentCalc(tokens, ++index, error);
-        assignNode->children.push_back(left);
-        assignNode->children.push_back(right);
-        return assignNode;
-    }
-    return left;
-}
-
-// Function to parse logical expressions
-Node *parseLogicOrCalc(const vector<Token> &tokens, int &index, bool &error)
-{
-    if (error)
-    {
-        return nullptr;
-    }
-    Node *left = parseLogicXorCalc(tokens, index, error);
-    while (matchCalc(tokens, index, "|"))
-    {
-        Token opToken = tokens[index++];
-        Node *right = parseLogicXorCalc(tokens, index, error);
-        Node *opNode = makeNodeCalc(opToken);
-        opNode->children.push_back(left);
-        opNode->children.push_back(right);
-        left = opNode;
-    }
-    return left;
-}
-
-// Parses the XOR logic expression from the given tokens
-Node *parseLogicXorCalc(const vector<Token> &tokens, int &index, bool &error)
-{
-    if (error)
-    {
-        return nullptr;
-    }
-    Node *left = parseLogicAndCalc(tokens, index, error);
-    while (matchCalc(tokens, index, "^"))
-    {
-        Token opToken = tokens[index++];
-        Node *right = parseLogicAndCalc(tokens, index, error);
-        Node *opNode = makeNodeCalc(opToken);
-        opNode->children.push_back(left);
-        opNode->children.push_back(right);
-        left = opNode;
-    }
-    return left;
-}
-
-// Parses the AND logic expression from the given tokens
-Node *parseLogicAndCalc(const vector<Token> &tokens, int &index, bool &error)
-{
-    if (error)
+    // find the expression's last token, jumping through the structural index
+    // instead of walking the tokens; none ends it if it runs to the last one
+    size_t last = tokens.size() - 1;
+    if (braceCheck)
     {
-        return nullptr;
+        last = findStructural(tokens, startOfExpression + 1, tokens.size(), '{') - 1;
     }
-    Node *left = parseEqualityCalc(tokens, index, error);
-    while (matchCalc(tokens, index, "&"))
+    else if (bracketCheck || commaCheck || parenCheck)
     {
-        Token opToken = tokens[index++];
-        Node *right = parseEqualityCalc(tokens, index, error);
-        Node *opNode = makeNodeCalc(opToken);
-        opNode->children.push_back(left);
-        opNode->children.push_back(right);
-        left = opNode;
+        last = findListEnd(tokens, startOfExpression, tokens.size()) - 1;
     }
-    return left;
-}
-
-// Function to parse equality expressions
-Node *parseEqualityCalc(const vector<Token> &tokens, int &index, bool &error)
-{
-    if (error)
+    else if (matchCalc(tokens, startOfExpression, TokenKind::LEFT_BRACKET))
     {
-        return nullptr;
+        last = findStructural(tokens, startOfExpression, tokens.size() - 1, ';');
     }
-    Node *left = parseComparisonCalc(tokens, index, error);
-    bool isArray = false;
-    if (matchCalc(tokens, index, "]")) {
-        isArray = true;
-    }
-    if (isArray) {
-        index ++;
-    }
-    while (matchCalc(tokens, index, "==") || matchCalc(tokens, index, "!="))
+    else
     {
-        Token opToken = tokens[index++];
-        Node *right = parseComparisonCalc(tokens, index, error);
-        Node *opNode = makeNodeCalc(opToken);
-        opNode->children.push_back(left);
-        opNode->children.push_back(right);
-        left = opNode;
-    }
-    if (isArray) {
-        index --;
+        for (size_t x = startOfExpression; x < tokens.size() - 1; x++)
+        {
+            const Token &currToken = tokens[x];
+            const Token &nextToken = tokens[x + 1];
+            if (int(currToken.text.size()) != locate(nextToken.offset).line  || nextToken.type == END || currToken.kind == TokenKind::SEMICOLON)
+            {
+                last = x;
+                break;
+            }
+        }
     }
-    return left;
-}
-
-// Function to parse comparison expressions
-Node *parseComparisonCalc(const vector<Token> &tokens, int &index, bool &error)
-{
-    if (error)
+    bool ended = last < tokens.size() - 1;
+    if (ended)
     {
-        return nullptr;
+        index = last;
     }
-    Node *left = parseAddSubCalc(tokens, index, error);
-    while (matchCalc(tokens, index, "<") || matchCalc(tokens, index, "<=") ||
-           matchCalc(tokens, index, ">") || matchCalc(tokens, index, ">="))
+    size_t stop = ended ? last + 1 : last;
+    if (stop > size_t(startOfExpression))
     {
-        Token opToken = tokens[index++];
-        Node *right = parseAddSubCalc(tokens, index, error);
-        Node *opNode = makeNodeCalc(opToken);
-        opNode->children.push_back(left);
-        opNode->children.push_back(right);
-        left = opNode;
+        tokensExpression.assign(tokens.begin() + startOfExpression, tokens.begin() + stop);
     }
-    return left;
+    int assignIndex = 0;
+    return parseAssignmentCalc(tokensExpression, assignIndex, error);
 }
 
-// Function to parse addition and subtraction expressions
-Node *parseAddSubCalc(const vector<Token> &tokens, int &index, bool &error)
+// Function to parse a whole expression, starting from its loosest operator
+Node *parseAssignmentCalc(const vector<Token> &tokens, int &index, bool &error)
 {
-    if (error)
-    {
-        return nullptr;
-    }
-    Node *left = parseMultDivModCalc(tokens, index, error);
-    while (matchCalc(tokens, index, "+") || matchCalc(tokens, index, "-"))
-    {
-        Token opToken = tokens[index++];
-        Node *right = parseMultDivModCalc(tokens, index, error);
-        Node *opNode = makeNodeCalc(opToken);
-        opNode->children.push_back(left);
-        opNode->children.push_back(right);
-        left = opNode;
-    }
-    return left;
+    return parseBinaryCalc(tokens, index, ASSIGNMENT, error);
 }
 
-// Function to parse multiplication, division, and modulo expressions
-Node *parseMultDivModCalc(const vector<Token> &tokens, int &index, bool &error)
+// Parses a primary expression and the operators after it that bind at least
+// as tightly as minimum, climbing the shared precedence table like
+// parseBinary. It keeps one quirk of calc's parser: a ] ending the first
+// operand of the equality level is stepped over to look for == and != behind
+// it, and stepped back onto afterwards, after which only operators looser than
+// equality are taken.
+Node *parseBinaryCalc(const vector<Token> &tokens, int &index, Precedence minimum, bool &error)
 {
     if (error)
     {
         return nullptr;
     }
     Node *left = parsePrimaryCalc(tokens, index, error);
-    while (matchCalc(tokens, index, "*") || matchCalc(tokens, index, "/") || matchCalc(tokens, index, "%"))
-    {
-        Token opToken = tokens[index++];
-        Node *right = parsePrimaryCalc(tokens, index, error);
-        Node *opNode = makeNodeCalc(opToken);
+    // the tightest operator the loop may still take; a right operand normally
+    // takes every tighter one, but not when it ends at such a ]
+    Precedence ceiling = MULTIPLICATIVE;
+    bool equalityChecked = minimum > EQUALITY;
+    while (!error)
+    {
+        Precedence precedence = index < int(tokens.size()) ? binaryPrecedence(tokens[index]) : NO_PRECEDENCE;
+        if (!equalityChecked && (precedence < COMPARISON || precedence > ceiling))
+        {
+            equalityChecked = true;
+            if (matchCalc(tokens, index, TokenKind::RIGHT_BRACKET))
+            {
+                index++;
+                while (!error && (matchCalc(tokens, index, TokenKind::EQ) || matchCalc(tokens, index, TokenKind::NE)))
+                {
+                    Node *opNode = makeNodeCalc(tokens[index++]);
+                    Node *right = parseBinaryCalc(tokens, index, COMPARISON, error);
+                    opNode->children.push_back(left);
+                    opNode->children.push_back(right);
+                    left = opNode;
+                }
+                index--;
+                ceiling = LOGIC_AND;
+                continue;
+            }
+        }
+        if (precedence < minimum || precedence > ceiling)
+        {
+            break;
+        }
+        Node *opNode = makeNodeCalc(tokens[index++]);
+        bool assignment = precedence == ASSIGNMENT;
+        Node *right = parseBinaryCalc(tokens, index, assignment ? ASSIGNMENT : Precedence(precedence + 1), error);
         opNode->children.push_back(left);
         opNode->children.push_back(right);
+        if (assignment)
+        {
+            return opNode;
+        }
         left = opNode;
+        ceiling = precedence;
     }
     return left;
 }
@@ -410,7 +236,7 @@ Node *parsePrimaryCalc(const vector<Token> &tokens, int &index, bool &error)
     }
     else if (token.type == BOOLEAN) {
         // cout << "normal identifier" << endl;
-        if (matchCalc(tokens, index, "["))
+        if (matchCalc(tokens, index, TokenKind::LEFT_BRACKET))
         {
             Node *identifier = makeNodeCalc(token);
             ArrayAssignNode *arrayAssign = parseArrayAssignCalc(tokens, index, error);
@@ -426,7 +252,7 @@ Node *parsePrimaryCalc(const vector<Token> &tokens, int &index, bool &error)
         // cout << "no shot we are making lit nodes"   << endl;
         ArrayLiteralNode *array = parseArrayLiteralCalc(tokens, index, error);
         // cout << "current token text: " << tokens[index].text << endl;
-        if (matchCalc(tokens, index + 1, "["))
+        if (matchCalc(tokens, index + 1, TokenKind::LEFT_BRACKET))
         {
             index++;
             // cout << "parsing lit going into assign" << endl;
@@ -442,14 +268,14 @@ Node *parsePrimaryCalc(const vector<Token> &tokens, int &index, bool &error)
     else if (token.type == IDENTIFIER)
     {
         // cout << "normal identifier" << endl;
-        if (matchCalc(tokens, index, "["))
+        if (matchCalc(tokens, index, TokenKind::LEFT_BRACKET))
         {
             Node *identifier = makeNodeCalc(token);
             ArrayAssignNode *arrayAssign = parseArrayAssignCalc(tokens, index, error);
             arrayAssign->expression = identifier;
             return arrayAssign;
         }
-        else if (matchCalc(tokens, index, "("))
+        else if (matchCalc(tokens, index, TokenKind::LEFT_PAREN))
         {
             // cout << "Parsing function call: " << token.text << endl;
             return parseFunctCallCalc(tokens, index, error);
@@ -462,14 +288,13 @@ Node *parsePrimaryCalc(const vector<Token> &tokens, int &index, bool &error)
     else if (token.type == TokenType::LEFT_PAREN)
     {
         Node *expression = parseAssignmentCalc(tokens, index, error);
-        if (!matchCalc(tokens, index, ")"))
+        if (!matchCalc(tokens, index, TokenKind::RIGHT_PAREN))
         {
             // Handle missing closing parenthesis error
             if (index < int(tokens.size()) && !error)
             {
                 printErrorCalc(tokens[index], error);
             }
-            deleteNodeCalc(expression);
             return nullptr;
         }
         ++index; // Increment index to skip the closing parenthesis
@@ -490,11 +315,11 @@ ArrayLiteralNode *parseArrayLiteralCalc(const vector<Token> &tokens, int &index,
     {
         return nullptr;
     }
-    ArrayLiteralNode *aLNode = makeArrayLiteralNodeCalc(tokens[index - 1]);
+    ArrayLiteralNode *aLNode = makeArrayLiteralNodeCalc();
 
     // cout << "Text of token: " << tokens[index].text << endl;
     //  keep parsing until close bracket
-    while (!matchCalc(tokens, index, "]"))
+    while (!matchCalc(tokens, index, TokenKind::RIGHT_BRACKET))
     {
         // each parse will return a node that will be pushed into while node's vector
         Node *node = parseExpressionCalc(tokens, index, error);
@@ -504,7 +329,7 @@ ArrayLiteralNode *parseArrayLiteralCalc(const vector<Token> &tokens, int &index,
             aLNode->array.push_back(node);
         }
         index++;
-        if (matchCalc(tokens, index, "]"))
+        if (matchCalc(tokens, index, TokenKind::RIGHT_BRACKET))
         {
             break;
         }
@@ -520,7 +345,7 @@ ArrayAssignNode *parseArrayAssignCalc(const vector<Token> &tokens, int &index, b
         return nullptr;
     }
     // set array asign node to the variable before the [
-    ArrayAssignNode *aANode = makeArrayAssignNodeCalc(tokens[index - 1]);
+    ArrayAssignNode *aANode = makeArrayAssignNodeCalc();
     // move index to the statement in []
     index++;
     aANode->arrayIndex = parseExpressionCalc(tokens, index, error);
@@ -529,24 +354,24 @@ ArrayAssignNode *parseArrayAssignCalc(const vector<Token> &tokens, int &index, b
     return aANode;
 }
 
-// Utility function to check if the current token matches the expected token type
-bool matchCalc(const vector<Token> &tokens, int index, string expectedType)
+// Utility function to check if the current token is of the expected kind
+bool matchCalc(const vector<Token> &tokens, int index, TokenKind expected)
 {
     if (index >= int(tokens.size()))
     {
         return false;
     }
-    return tokens[index].text == expectedType;
+    return tokens[index].kind == expected;
 }
 
 // Throws runtime error for unknown identifier
-bool checkIdenCalc(Node *root, unordered_map<string, Value> &variables, bool &error)
+bool checkIdenCalc(Node *root, unordered_map<int, Value> &variables, bool &error)
 {
     if (!root)
     {
         return true;
     }
-    if (root->token.text == "=")
+    if (root->token.kind == TokenKind::ASSIGN)
     {
         bool check = checkIdenCalc(root->children[root->children.size() - 1], variables, error);
         return check;
@@ -554,10 +379,10 @@ bool checkIdenCalc(Node *root, unordered_map<string, Value> &variables, bool &er
     // If the node is an IDENTIFIER token, check if it exists in the variables map
     else if (root->token.type == IDENTIFIER)
     {
-        string identifierText = root->token.text;
+        string identifierText(root->token.text);
 
         // Check if the identifier exists in the variables unordered_map
-        auto iter = variables.find(identifierText);
+        auto iter = variables.find(root->token.symbol);
         if (iter == variables.end())
         {
             // Handle error: Unknown identifier
@@ -585,34 +410,19 @@ bool checkParenCalc(vector<Token> &tokens, bool &error)
     {
         return false;
     }
-    int count = 0;
-    Token lastToken;
-
-    for (const Token &token : tokens)
+    // the structural index counted the line's parentheses when it was built
+    const SourceStructure &structure = sourceStructure();
+    if (structure.strayParen >= 0)
     {
-        if (token.text == "(")
-        {
-            count++;
-        }
-        else if (token.text == ")")
-        {
-            count--;
-
-            if (count < 0)
-            {
-                // More right parentheses than left parentheses
-                printErrorCalc(token, error);
-                return false;
-            }
-        }
-
-        lastToken = token;
+        // More right parentheses than left parentheses
+        printErrorCalc(tokens[tokenAt(tokens, uint32_t(structure.strayParen))], error);
+        return false;
     }
 
-    if (count > 0)
+    if (structure.openParens > 0)
     {
         // More left parentheses than right parentheses
-        printErrorCalc(lastToken, error);
+        printErrorCalc(tokens.back(), error);
         return false;
     }
 
@@ -621,39 +431,25 @@ bool checkParenCalc(vector<Token> &tokens, bool &error)
 
 Value returnVal = Value{numeric_limits<double>::quiet_NaN()};
 
-Value evaluateAllCalc(Node *node, unordered_map<string, Value> &variables, bool &error, bool &inFunct)
+Value evaluateAllCalc(Node *node, unordered_map<int, Value> &variables, bool &error, bool &inFunct)
 {
-    if (ReturnNode *rNode = dynamic_cast<ReturnNode *>(node))
-    {
-        // Node is a ReturnNode
-        return evaluateReturnCalc(rNode, variables, error, inFunct);
-    }
-    else if (FunctDefNode *fdNode = dynamic_cast<FunctDefNode *>(node))
-    {
-        // Node is a FunctDefNode
-        return evaluateFunctDefCalc(fdNode, variables, error, inFunct);
-    }
-    else if (FunctCallNode *fcNode = dynamic_cast<FunctCallNode *>(node))
-    {
-        // Node is a FunctCallNode
-        return evaluateFunctCallCalc(fcNode, variables, error, inFunct);
-    }
-    else if (ArrayLiteralNode *alNode = dynamic_cast<ArrayLiteralNode *>(node))
-    {
-        // Node is an ArrayLiteralNode
-        return evaluateArrayLiteralCalc(alNode, variables, error, inFunct);
-    }
-    else if (ArrayAssignNode *alNode = dynamic_cast<ArrayAssignNode *>(node))
-    {
-        // Node is an ArrayAssignNode
-        return evaluateArrayAssignCalc(alNode, variables, error, inFunct, false);
-    }
-    else
-    {
+    // a missing node is left to evaluateExpressionCalc, like a normal Node
+    switch (node ? node->kind : CalcNodeKind::EXPRESSION)
+    {
+    case CalcNodeKind::RETURN:
+        return evaluateReturnCalc(static_cast<ReturnNode *>(node), variables, error, inFunct);
+    case CalcNodeKind::FUNCT_DEF:
+        return evaluateFunctDefCalc(static_cast<FunctDefNode *>(node), variables, error, inFunct);
+    case CalcNodeKind::FUNCT_CALL:
+        return evaluateFunctCallCalc(static_cast<FunctCallNode *>(node), variables, error, inFunct);
+    case CalcNodeKind::ARRAY_LITERAL:
+        return evaluateArrayLiteralCalc(static_cast<ArrayLiteralNode *>(node), variables, error, inFunct);
+    case CalcNodeKind::ARRAY_ASSIGN:
+        return evaluateArrayAssignCalc(static_cast<ArrayAssignNode *>(node), variables, error, inFunct, false);
+    default:
         // Node is a normal Node
         return evaluateExpressionCalc(node, variables, error, inFunct);
     }
-    return Value{numeric_limits<double>::quiet_NaN()};
 }
 
 
@@ -701,7 +497,7 @@ void printValueCalc(Value value)
 }
 
 // Evaluates a return statement.
-Value evaluateReturnCalc(ReturnNode *node, unordered_map<string, Value> &variables, bool &error, bool &inFunct)
+Value evaluateReturnCalc(ReturnNode *node, unordered_map<int, Value> &variables, bool &error, bool &inFunct)
 {
     // cout << "eval return" << endl;
     if (!node || error)
@@ -726,7 +522,7 @@ Value evaluateReturnCalc(ReturnNode *node, unordered_map<string, Value> &variabl
 }
 
 // Evaluates a function definition.
-Value evaluateFunctDefCalc(FunctDefNode *node, unordered_map<string, Value> &variables, bool &error, bool &inFunct)
+Value evaluateFunctDefCalc(FunctDefNode *node, unordered_map<int, Value> &variables, bool &error, bool &inFunct)
 {
     // cout << "Function " << node->functname.text << " defined." << endl;
     if (!node || error)
@@ -737,7 +533,7 @@ Value evaluateFunctDefCalc(FunctDefNode *node, unordered_map<string, Value> &var
     Function func;
     func.function = node;
     func.functVariables = variables;
-    variables[node->functname.text] = Value{make_shared<Function>(func)};
+    variables[node->functname.symbol] = Value{make_shared<Function>(func)};
 
     // debugging scope
     // cout << "function def scope: " << endl;
@@ -753,7 +549,7 @@ Value evaluateFunctDefCalc(FunctDefNode *node, unordered_map<string, Value> &var
 }
 
 // Evaluates a function call.
-Value evaluateFunctCallCalc(FunctCallNode *node, unordered_map<string, Value> &variables, bool &error, bool &inFunct)
+Value evaluateFunctCallCalc(FunctCallNode *node, unordered_map<int, Value> &variables, bool &error, bool &inFunct)
 {
     // cout << "Function " << node->functname.text << " called." << endl;
     if (!node || error)
@@ -767,7 +563,7 @@ Value evaluateFunctCallCalc(FunctCallNode *node, unordered_map<string, Value> &v
     }
 
     // check if function exists
-    auto iter = variables.find(node->functname.text);
+    auto iter = variables.find(node->functname.symbol);
     if (iter == variables.end()) 
     {
         // cout << "can't find: " << node->functname.text << endl;
@@ -802,10 +598,10 @@ Value evaluateFunctCallCalc(FunctCallNode *node, unordered_map<string, Value> &v
     }
 
     // create new scope for function call
-    unordered_map<string, Value> newVariables = function->functVariables;
+    unordered_map<int, Value> newVariables = function->functVariables;
     for (size_t i = 0; i < function->function->params.size(); i++)
     {
-        newVariables[function->function->params[i]] = evaluatedArguments[i];
+        newVariables[function->function->paramSymbols[i]] = evaluatedArguments[i];
     }
 
     for (const auto& entry : variables) {
@@ -833,7 +629,7 @@ Value evaluateFunctCallCalc(FunctCallNode *node, unordered_map<string, Value> &v
     return Value{nullptr};
 }
 
-Value evaluateUtilityFunctCalc(FunctCallNode *node, unordered_map<string, Value> &variables, bool &error, bool &inFunct)
+Value evaluateUtilityFunctCalc(FunctCallNode *node, unordered_map<int, Value> &variables, bool &error, bool &inFunct)
 {
     bool argCountError = false;
     if (node->functname.text == "len")
@@ -888,7 +684,7 @@ Value evaluateUtilityFunctCalc(FunctCallNode *node, unordered_map<string, Value>
 
 
 // Evaluates an array literal
-Value evaluateArrayLiteralCalc(ArrayLiteralNode *node, unordered_map<string, Value> &variables, bool &error, bool &inFunct) 
+Value evaluateArrayLiteralCalc(ArrayLiteralNode *node, unordered_map<int, Value> &variables, bool &error, bool &inFunct) 
 {
     // cout << "eval array literal" << endl;
     if (!node || error)
@@ -903,7 +699,7 @@ Value evaluateArrayLiteralCalc(ArrayLiteralNode *node, unordered_map<string, Val
     return Value{make_shared<vector<Value>>(evaluatedArray)};
 }
 
-Value evaluateArrayAssignCalc(ArrayAssignNode *node, unordered_map<string, Value> &variables, bool &error, bool &inFunct, bool setValue)
+Value evaluateArrayAssignCalc(ArrayAssignNode *node, unordered_map<int, Value> &variables, bool &error, bool &inFunct, bool setValue)
 {
     // cout << "eval array assign" << endl;
     if (!node || error)
@@ -947,7 +743,7 @@ Value evaluateArrayAssignCalc(ArrayAssignNode *node, unordered_map<string, Value
 }
 
 // Evaluates an expression given the root of the expression's AST.
-Value evaluateExpressionCalc(Node *node, unordered_map<string, Value> &variables, bool &error, bool &inFunct)
+Value evaluateExpressionCalc(Node *node, unordered_map<int, Value> &variables, bool &error, bool &inFunct)
 {
     // cout << "eval expression, root is " << node->token.text << endl;
     if (!node || error)
@@ -957,24 +753,20 @@ Value evaluateExpressionCalc(Node *node, unordered_map<string, Value> &variables
     // If the node holds a FLOAT token, simply return its value.
     if (node->token.type == FLOAT)
     {
-        Value result{stod(node->token.text)};
+        Value result{numberValue(node->token)};
         // cout << "returning float " << get<double>(result) << " ";
         return result;
     }
-    if (FunctCallNode *fcNode = dynamic_cast<FunctCallNode *>(node))
-    {
-        // Node is a FunctCallNode
-        return evaluateFunctCallCalc(fcNode, variables, error, inFunct);
-    }
-    if (ArrayLiteralNode *aLNode = dynamic_cast<ArrayLiteralNode *>(node))
-    {
-        // Node is an ArrayLiteralNode
-        return evaluateArrayLiteralCalc(aLNode, variables, error, inFunct);
-    }
-    if (ArrayAssignNode *aANode = dynamic_cast<ArrayAssignNode *>(node))
+    switch (node->kind)
     {
-        // Node is an ArrayAssignNode
-        return evaluateArrayAssignCalc(aANode, variables, error, inFunct, false);
+    case CalcNodeKind::FUNCT_CALL:
+        return evaluateFunctCallCalc(static_cast<FunctCallNode *>(node), variables, error, inFunct);
+    case CalcNodeKind::ARRAY_LITERAL:
+        return evaluateArrayLiteralCalc(static_cast<ArrayLiteralNode *>(node), variables, error, inFunct);
+    case CalcNodeKind::ARRAY_ASSIGN:
+        return evaluateArrayAssignCalc(static_cast<ArrayAssignNode *>(node), variables, error, inFunct, false);
+    default:
+        break;
     }
     // If the node holds a BOOLEAN token, simply return its value.
     if (node->token.type == BOOLEAN)
@@ -996,10 +788,10 @@ Value evaluateExpressionCalc(Node *node, unordered_map<string, Value> &variables
     // NOTE: This only runs if an IDENTIFIER is found not during assignment
     if (node->token.type == IDENTIFIER)
     {
-        string identifierText = node->token.text;
+        string identifierText(node->token.text);
 
         // Check if the identifier exists in the variables unordered_map
-        auto iter = variables.find(identifierText);
+        auto iter = variables.find(node->token.symbol);
         if (iter != variables.end())
         {
             // Return the value of the identifier
@@ -1026,8 +818,9 @@ Value evaluateExpressionCalc(Node *node, unordered_map<string, Value> &variables
         Value result = evaluateExpressionCalc(node->children[node->children.size() - 1], variables, error, inFunct);
         for (int i = int(node->children.size() - 2); i >= 0; i--)
         {
-            if (ArrayAssignNode *aANode = dynamic_cast<ArrayAssignNode *>(node->children[i]))
+            if (node->children[i] && node->children[i]->kind == CalcNodeKind::ARRAY_ASSIGN)
             {
+                ArrayAssignNode *aANode = static_cast<ArrayAssignNode *>(node->children[i]);
                 // cout << "array assign found" << endl;
                 Value array = evaluateArrayAssignCalc(aANode, variables, error, inFunct, true);
                 if (error) {
@@ -1048,7 +841,7 @@ Value evaluateExpressionCalc(Node *node, unordered_map<string, Value> &variables
             }
             else
             {
-                variables[node->children[i]->token.text] = result;
+                variables[node->children[i]->token.symbol] = result;
             }
             // cout << variables[node->children[i]->token.text].index() << endl;
         }
@@ -1284,8 +1077,8 @@ Value popCalc(Value array, bool& error) {
 
 void printFunctCallCalc(const Node *node)
 {
-    const FunctCallNode* functCallNode = dynamic_cast<const FunctCallNode*>(node);
-    if (functCallNode) {
+    if (node->kind == CalcNodeKind::FUNCT_CALL) {
+        const FunctCallNode* functCallNode = static_cast<const FunctCallNode*>(node);
         cout << functCallNode->functname.text << "(";
         for (size_t i = 0; i < functCallNode->arguments.size(); i++) {
             printInfixCalc(functCallNode->arguments[i]);
@@ -1300,21 +1093,8 @@ void printFunctCallCalc(const Node *node)
 // Prints the infix notation of a given AST.
 void printInfixCalc(Node *node) 
 {
-    bool isFunctCall = false;
-    bool isArrayAssignOrArrayLiteral = false;
-
-    if(dynamic_cast<ArrayLiteralNode*>(node))
-    {
-        isArrayAssignOrArrayLiteral = true;
-    }
-    else if(dynamic_cast<ArrayAssignNode*>(node))
-    {
-        isArrayAssignOrArrayLiteral = true;
-    }
-    if (dynamic_cast<const FunctCallNode*>(node)) 
-    {
-        isFunctCall = true;
-    }
+    bool isFunctCall = node && node->kind == CalcNodeKind::FUNCT_CALL;
+    bool isArrayAssignOrArrayLiteral = node && (node->kind == CalcNodeKind::ARRAY_LITERAL || node->kind == CalcNodeKind::ARRAY_ASSIGN);
     if (!isArrayAssignOrArrayLiteral && !isFunctCall && node && (node->token.type != FLOAT && node->token.type != IDENTIFIER && node->token.type != BOOLEAN && node->token.type != NULLVAL)) 
     {
         cout << "(";
@@ -1334,12 +1114,13 @@ void printInfixHelperCalc(Node *node)
     {
         return;
     }
-    else if (const FunctCallNode *fcNode = dynamic_cast<const FunctCallNode*>(node))
+    else if (node->kind == CalcNodeKind::FUNCT_CALL)
     {
-        printFunctCallCalc(fcNode);
+        printFunctCallCalc(node);
     }
-    else if (ArrayLiteralNode *aLNode = dynamic_cast<ArrayLiteralNode*>(node))
+    else if (node->kind == CalcNodeKind::ARRAY_LITERAL)
     {
+        ArrayLiteralNode *aLNode = static_cast<ArrayLiteralNode *>(node);
         //cout << "length: " << aLNode->array.size() << endl;
         //cout << " HERE|" << node->token.text << "|HERE ";
         cout << "[";
@@ -1347,11 +1128,7 @@ void printInfixHelperCalc(Node *node)
         for (size_t i = 0; i < aLNode->array.size(); i++)
         {
             Node *currNode = aLNode->array[i];
-            if(dynamic_cast<ArrayLiteralNode*>(currNode))
-            {
-                isArrayAssignOrArrayLiteral = true;
-            }   
-            else if(dynamic_cast<ArrayAssignNode*>(currNode))
+            if (currNode && (currNode->kind == CalcNodeKind::ARRAY_LITERAL || currNode->kind == CalcNodeKind::ARRAY_ASSIGN))
             {
                 isArrayAssignOrArrayLiteral = true;
             }
@@ -1367,8 +1144,9 @@ void printInfixHelperCalc(Node *node)
         }
         cout << "]";
     }
-    else if (ArrayAssignNode *aANode = dynamic_cast<ArrayAssignNode*>(node))
+    else if (node->kind == CalcNodeKind::ARRAY_ASSIGN)
     {
+        ArrayAssignNode *aANode = static_cast<ArrayAssignNode *>(node);
         printInfixHelperCalc(aANode->expression);
         cout << "[";
         printInfixCalc(aANode->arrayIndex);
@@ -1376,7 +1154,7 @@ void printInfixHelperCalc(Node *node)
     }
     else if (node->token.type == FLOAT)
     {
-        double val = stod(node->token.text);
+        double val = numberValue(node->token);
         if (val == static_cast<int>(val))
             cout << static_cast<int>(val);
         else
@@ -1411,8 +1189,9 @@ void printInfixHelperCalc(Node *node)
 void printErrorCalc(const Token &token, bool &error)
 {
     error = true;
-    cout << "Unexpected token at line " << token.lineNumber
-         << " column " << token.columnNumber << ": "
+    SourceLocation location = locate(token.offset);
+    cout << "Unexpected token at line " << location.line
+         << " column " << location.column << ": "
          << token.text << endl;
 }
 
@@ -1420,26 +1199,29 @@ int main(int argc, const char **argv)
 {
     string input;
     string text;
-    unordered_map<string, Value> variables; // unordered_map<string, double> variables;
+    unordered_map<int, Value> variables; // unordered_map<string, double> variables;
 
     while (getline(cin, input)) // Keep reading until EOF
     {
-        vector<Token> tokens = readTokens(input);
+        SplicedTexts spliced;
+        vector<Token> tokens = readTokens(input, spliced);
         if (tokens.empty() || tokens.back().text == "error")
         {
             continue;
         }
+        indexStructure(input);
 
         bool error = false;
         bool inFunct = false;
         int index = 0;
         Node *root;
+        // the previous line's tree is done with, so its arena space is reused
+        nodeArena().reset();
         root = makeTreeCalc(tokens, index, error);
         // if (!checkVarCalc(root, error) || !checkParenCalc(tokens, error))
         if (!checkParenCalc(tokens, error))
         {
             // cout << "error from var or paren" << endl;
-            deleteNodeCalc(root);
             continue;
         }
         if (root != nullptr && !error) // here
@@ -1459,7 +1241,6 @@ int main(int argc, const char **argv)
             printValueCalc(result);
             cout << endl;
         }
-        deleteNodeCalc(root);
     }
 
     return 0;
@@ -1,4 +1,6 @@
 #include "lib/format.hpp"
+#include "lib/token_cache.hpp"
+#include "lib/structure.hpp"
 #include <unordered_map>
 #include <iostream>
 #include <stack>
@@ -8,194 +10,164 @@
 using namespace std;
 
 //Prints a AST given its root node keeps track of depth for indentation
-void printAll(Node *node, int &depth)
+void printAll(NodeIndex node, int &depth)
 {
     for(int j = 0; j < depth; j++)
     {
         cout << "    ";
     }
-    if (IfElseNode *iENode = dynamic_cast<IfElseNode*>(node)) {
-        // Node is a WhileNode
-        printIfElse(iENode, depth);
+    if (node != noNode)
+    {
+        switch (syntaxTree()[node].kind)
+        {
+        case NodeKind::IF_ELSE:
+            printIfElse(node, depth);
+            return;
+        case NodeKind::WHILE:
+            printWhile(node, depth);
+            return;
+        case NodeKind::PRINT:
+            printPrint(node);
+            return;
+        case NodeKind::FUNCTION_DEF:
+            printFunctDef(node, depth);
+            return;
+        case NodeKind::RETURN:
+            printReturn(node);
+            return;
+        default:
+            break;
+        }
     }
-    else if (WhileNode *wNode = dynamic_cast<WhileNode*>(node)) {
-        // Node is an IfElseNode
-        printWhile(wNode, depth);
-    } 
-    else if (PrintNode *pNode = dynamic_cast<PrintNode*>(node)) {
-        // Node is a PrintNode
-        printPrint(pNode);
-    } 
-    else if (FunctDefNode *fdNode = dynamic_cast<FunctDefNode*>(node)) {
-        // Node is a FunctDefNode
-        printFunctDef(fdNode, depth);
-    } 
-    else if (ReturnNode *rNode = dynamic_cast<ReturnNode*>(node)) {
-        // Node is a ReturnNode
-        printReturn(rNode);
-    } 
-    else {
-        // Node is a normal Node
-        printInfix(node, true);
-        cout << endl;
+    // Node is an expression
+    printInfix(node, true);
+    cout << endl;
+}
+
+// prints the statements of a block one level deeper, and the } closing it
+void printBlock(NodeIndex block, int &depth)
+{
+    const FlatTree &tree = syntaxTree();
+    depth ++;
+    for (const NodeIndex *statement = tree.childrenBegin(block); statement != tree.childrenEnd(block); statement++) {
+        printAll(*statement, depth);
     }
+    depth --;
+    for (int j = 0; j < depth; j++) {
+        cout << "    ";
+    }
+    cout << "}" << endl;
 }
 
 // prints the if/else node
-void printIfElse(const Node *node, int &depth) 
+void printIfElse(NodeIndex node, int &depth) 
 {
-    if (node)
-        cout << "if ";
-    const IfElseNode* ifElseNode = dynamic_cast<const IfElseNode*>(node);
-    if (ifElseNode) {
-        printInfix(ifElseNode->condition, false);
-        cout << " {" << endl;
-        depth ++;
-        for (size_t i = 0; i < ifElseNode->statementsTrue.size(); i++) {
-            printAll(ifElseNode->statementsTrue[i], depth);
-        }
-        depth --;
-        for (int j = 0; j < depth; j++) {
+    const FlatTree &tree = syntaxTree();
+    cout << "if ";
+    printInfix(tree.child(node, 0), false);
+    cout << " {" << endl;
+    printBlock(tree.child(node, 1), depth);
+    // only an if with an else has a third child
+    if (tree[node].count == 3) {
+        for(int j = 0; j < depth; j++) {
             cout << "    ";
         }
-        cout << "}" << endl;
-        if (ifElseNode->hasElse) {
-            for(int j = 0; j < depth; j++) {
-                cout << "    ";
-            }
-            cout << "else {" << endl;
-            depth ++;
-            for (size_t i = 0; i < ifElseNode->statementsFalse.size(); i++) {
-                printAll(ifElseNode->statementsFalse[i], depth);
-            }
-            depth --;
-            for (int j = 0; j < depth; j++) {
-                cout << "    ";
-            }
-            cout << "}" << endl;
-        }
+        cout << "else {" << endl;
+        printBlock(tree.child(node, 2), depth);
     }
 }
 
 // prints the while node
-void printWhile(const Node *node, int &depth) 
+void printWhile(NodeIndex node, int &depth) 
 {
-    if (node)
-        cout << "while ";
-    const WhileNode* whileNode = dynamic_cast<const WhileNode*>(node);
-    if (whileNode) {
-        printInfix(whileNode->condition, false);
-        cout << " {" << endl;
-        depth ++;
-        for (size_t i = 0; i < whileNode->statements.size(); i++) {
-            printAll(whileNode->statements[i], depth);
-        }
-        depth --;
-        for (int j = 0; j < depth; j++)
-        {
-            cout << "    ";
-        }
-        cout << "}" << endl;
-    }
+    const FlatTree &tree = syntaxTree();
+    cout << "while ";
+    printInfix(tree.child(node, 0), false);
+    cout << " {" << endl;
+    printBlock(tree.child(node, 1), depth);
 }
 
 // prints the print node
-void printPrint(const Node *node) 
+void printPrint(NodeIndex node) 
 {
-    if (node)
-        cout << "print ";
-    const PrintNode* printNode = dynamic_cast<const PrintNode*>(node);
-    if (printNode) {
-        printInfix(printNode->expression, true);
-        cout << endl;
-    }
+    cout << "print ";
+    printInfix(syntaxTree().child(node, 0), true);
+    cout << endl;
 }
 
-void printFunctDef(const Node *node, int &depth)
+void printFunctDef(NodeIndex node, int &depth)
 {
-    if (node)
-        cout << "def ";
-    const FunctDefNode* functDefNode = dynamic_cast<const FunctDefNode*>(node);
-    if (functDefNode) {
-        cout << functDefNode->functname.text << "(";
-        for (size_t i = 0; i < functDefNode->params.size(); i++) {
-            cout << functDefNode->params[i];
-            if (i != functDefNode->params.size() - 1) {
-                cout << ", ";
-            }
+    const FlatTree &tree = syntaxTree();
+    NodeIndex params = tree.child(node, 0);
+    cout << "def ";
+    cout << tree.token(node).text << "(";
+    for (uint32_t i = 0; i < tree[params].count; i++) {
+        cout << tree.token(tree.child(params, i)).text;
+        if (i != tree[params].count - 1) {
+            cout << ", ";
         }
-        cout << ") ";
-        cout << "{" << endl;
-        depth ++;
-        for (size_t i = 0; i < functDefNode->statements.size(); i++) {
-            printAll(functDefNode->statements[i], depth);
-        }
-        depth --;
-        for (int j = 0; j < depth; j++)
-        {
-            cout << "    ";
-        }
-        cout << "}" << endl;
     }
+    cout << ") ";
+    cout << "{" << endl;
+    printBlock(tree.child(node, 1), depth);
 }
 
-void printReturn(const Node *node)
+void printReturn(NodeIndex node)
 {
-    if (node)
-        cout << "return";
-    const ReturnNode* returnNode = dynamic_cast<const ReturnNode*>(node);
-    if (returnNode) {
-        if (returnNode->expression) {
-            cout << " ";
-            printInfix(returnNode->expression, true);
-        }
-        else {
-            cout << ";";
-        }
-        cout << endl;
+    const FlatTree &tree = syntaxTree();
+    cout << "return";
+    if (tree[node].count != 0) {
+        cout << " ";
+        printInfix(tree.child(node, 0), true);
+    }
+    else {
+        cout << ";";
     }
+    cout << endl;
 }
 
-void printFunctCall(const Node *node)
+void printFunctCall(NodeIndex node)
 {
-    const FunctCallNode* functCallNode = dynamic_cast<const FunctCallNode*>(node);
-    if (functCallNode) {
-        cout << functCallNode->functname.text << "(";
-        for (size_t i = 0; i < functCallNode->arguments.size(); i++) {
-            printInfix(functCallNode->arguments[i], false);
-            if (i != functCallNode->arguments.size() - 1) {
-                cout << ", ";
-            }
+    const FlatTree &tree = syntaxTree();
+    cout << tree.token(node).text << "(";
+    for (uint32_t i = 0; i < tree[node].count; i++) {
+        printInfix(tree.child(node, i), false);
+        if (i != tree[node].count - 1) {
+            cout << ", ";
         }
-        cout << ")";
     }
+    cout << ")";
 }
 
 
 // Prints the infix notation of a given AST.
-void printInfix(Node *node, bool semi) 
+void printInfix(NodeIndex node, bool semi) 
 {
-    bool isFunctCall = false;
-    bool isArrayAssignOrArrayLiteral = false;
-
-    if(dynamic_cast<ArrayLiteralNode*>(node))
-    {
-        isArrayAssignOrArrayLiteral = true;
-    }
-    else if(dynamic_cast<ArrayAssignNode*>(node))
+    // only operators are wrapped in parentheses; literals, names, arrays and
+    // calls stand on their own
+    bool parenthesize = false;
+    if (node != noNode)
     {
-        isArrayAssignOrArrayLiteral = true;
-    }
-    if (dynamic_cast<const FunctCallNode*>(node)) 
-    {
-        isFunctCall = true;
+        switch (syntaxTree()[node].kind)
+        {
+        case NodeKind::NUMBER:
+        case NodeKind::BOOLEAN:
+        case NodeKind::NULL_VALUE:
+        case NodeKind::IDENTIFIER:
+        case NodeKind::ARRAY_LITERAL:
+        case NodeKind::ARRAY_INDEX:
+        case NodeKind::FUNCTION_CALL:
+            break;
+        default:
+            parenthesize = true;
+        }
     }
-    if (!isArrayAssignOrArrayLiteral && !isFunctCall && node && (node->token.type != FLOAT && node->token.type != IDENTIFIER && node->token.type != BOOLEAN && node->token.type != NULLVAL)) 
+    if (parenthesize) 
     {
         cout << "(";
     }
     printInfixHelper(node);
-    if (!isArrayAssignOrArrayLiteral && !isFunctCall && node && (node->token.type != FLOAT && node->token.type != IDENTIFIER && node->token.type != BOOLEAN && node->token.type != NULLVAL)) 
+    if (parenthesize) 
     {
         cout << ")";
     }
@@ -205,120 +177,108 @@ void printInfix(Node *node, bool semi)
 }
 
 // Prints the infix notation of a given AST.
-void printInfixHelper(Node *node)
+void printInfixHelper(NodeIndex node)
 {
-    //cout << " |" << node->token.text << "| ";
-    if (!node)
+    //cout << " |" << syntaxTree().token(node).text << "| ";
+    if (node == noNode)
     {
         return;
     }
-    else if (const FunctCallNode *fcNode = dynamic_cast<const FunctCallNode*>(node))
+    const FlatTree &tree = syntaxTree();
+    switch (tree[node].kind)
     {
-        printFunctCall(fcNode);
-    }
-    else if (ArrayLiteralNode *aLNode = dynamic_cast<ArrayLiteralNode*>(node))
+    case NodeKind::FUNCTION_CALL:
+        printFunctCall(node);
+        break;
+    case NodeKind::ARRAY_LITERAL:
     {
-        //cout << "length: " << aLNode->array.size() << endl;
-        //cout << " HERE|" << node->token.text << "|HERE ";
         cout << "[";
+        // once an element is an array literal, no later element is wrapped
+        // in parentheses either
         bool isArrayAssignOrArrayLiteral = false;
-        for (size_t i = 0; i < aLNode->array.size(); i++)
+        for (uint32_t i = 0; i < tree[node].count; i++)
         {
-            Node *currNode = aLNode->array[i];
-            if(dynamic_cast<ArrayLiteralNode*>(currNode))
-            {
-                isArrayAssignOrArrayLiteral = true;
-            }   
-            else if(dynamic_cast<ArrayAssignNode*>(node))
+            NodeIndex currNode = tree.child(node, i);
+            if (currNode != noNode && tree[currNode].kind == NodeKind::ARRAY_LITERAL)
             {
                 isArrayAssignOrArrayLiteral = true;
             }
-            if (!isArrayAssignOrArrayLiteral && currNode && (currNode->token.type != FLOAT && currNode->token.type != IDENTIFIER && currNode->token.type != BOOLEAN))
+            // null, unlike the other literals, is wrapped here
+            bool parenthesize = !isArrayAssignOrArrayLiteral && currNode != noNode &&
+                                tree[currNode].kind != NodeKind::NUMBER && tree[currNode].kind != NodeKind::IDENTIFIER &&
+                                tree[currNode].kind != NodeKind::BOOLEAN;
+            if (parenthesize)
                 cout << "(";
             printInfixHelper(currNode);
-            if (!isArrayAssignOrArrayLiteral && currNode && (currNode->token.type != FLOAT && currNode->token.type != IDENTIFIER && currNode->token.type != BOOLEAN))
+            if (parenthesize)
                 cout << ")";
-            if (i != aLNode->array.size() - 1)
+            if (i != tree[node].count - 1)
             {
                 cout << ", ";
             }
         }
         cout << "]";
+        break;
     }
-    else if (ArrayAssignNode *aANode = dynamic_cast<ArrayAssignNode*>(node))
-    {
-        printInfixHelper(aANode->expression);
+    case NodeKind::ARRAY_INDEX:
+        printInfixHelper(tree.child(node, 0));
         cout << "[";
-        printInfixHelper(aANode->arrayIndex);
+        printInfixHelper(tree.child(node, 1));
         cout << "]";
-    }
-    else if (node->token.type == FLOAT)
+        break;
+    case NodeKind::NUMBER:
     {
-        double val = stod(node->token.text);
+        double val = tree.number(node);
         if (val == static_cast<int>(val))
             cout << static_cast<int>(val);
         else
-            cout << node->token.text;
-    }
-    else if (node->token.type == IDENTIFIER || node->token.type == BOOLEAN || node->token.type == NULLVAL)
-    {
-        cout << node->token.text;
+            cout << tree.token(node).text;
+        break;
     }
-    else
+    case NodeKind::IDENTIFIER:
+    case NodeKind::BOOLEAN:
+    case NodeKind::NULL_VALUE:
+        cout << tree.token(node).text;
+        break;
+    default:
     {
         bool isFirst = true;
-        //cout << "node text: " << node->token.text << endl;
-        for (const auto &child : node->children)
+        for (const NodeIndex *child = tree.childrenBegin(node); child != tree.childrenEnd(node); child++)
         {
-            if (!child)
+            if (*child == noNode)
                 continue;
             if (!isFirst)
             {
-                cout << " " << node->token.text << " ";
+                cout << " " << tree.token(node).text << " ";
             }
             else
             {
                 isFirst = false;
             }
-            printInfix(child, false);
+            printInfix(*child, false);
         }
     }
+    }
 }
 
 int main(int argc, const char **argv)
 {
-    string input;
-    string text;
-    vector<Token> tokens;
-
-    while (getline(cin, input))
-    {
-        text += input;
-        if (!cin.eof())
-        {
-            text += '\n';
-        }
-    }
-
-    tokens = readTokens(text);
+    // lex straight from the mapped file when a path is given, else from stdin,
+    // reusing the tokens of an earlier run on the same source when cached
+    SourceText source(argc > 1 ? argv[1] : nullptr);
+    vector<Token> tokens = readTokensCached(source.text(), source.spliced());
 
-    // set up variables for muti expression parsing
-    
-    int index = 0;
-    vector<Node*> trees;
     if (tokens.empty() || tokens.back().text == "error") //
     {
         exit(1);
     }
+    indexStructure(source.text());
+    syntaxTree().reset(tokens);
+    // the formatter prints every function body, so never leaves them unparsed
+    parseOptions().shareSubtrees = parseOptionsFromEnvironment().shareSubtrees;
 
     //parse the tokens and put into trees
-    while(tokens[index].type != END)
-    {
-        Node *root;
-        root = makeTree(tokens, index); 
-        trees.push_back(root);
-        index ++;
-    } 
+    vector<NodeIndex> trees = parseProgram(tokens);
     //out << "MADE IT PAST PARSING" << endl;
     //print and evaluate trees
     for (size_t i = 0; i < trees.size(); i++)
@@ -326,10 +286,5 @@ int main(int argc, const char **argv)
         int depth = 0;
         printAll(trees[i], depth);
     }
-    //delete trees
-    for (size_t i = 0; i < trees.size(); i++)
-    {  
-        deleteNodeAll(trees[i]);
-    }
     return 0;
 }
\ No newline at end of file
@@ -7,30 +7,21 @@ using namespace std;
 
 int main(int argc, const char **argv)
 {
-    string input;
-    string text;
-    vector<Token> tokens;
+    // pull tokens a chunk at a time and print each as it comes, so memory
+    // stays the same however long the input is. A chunk is lexed in full
+    // before any of its tokens are handed out, so a syntax error in an input
+    // that fits one chunk is still the only output.
+    TokenStream stream(cin);
+    Token token;
 
-    while (getline(cin, input))
+    while (stream.next(token))
     {
-        text += input;
-        if (!cin.eof())
-        {
-            text += '\n';
-        }
+        printToken(cout, token);
     }
-
-    // lex and then check for lex errors
-    tokens = readTokens(text);
-
-    if (tokens.empty() || tokens.back().text == "error")
+    if (stream.failed())
     {
         exit(1);
     }
-    if (!tokens.empty())
-    {
-        printTokens(tokens);
-    }
 
     return 0;
 }
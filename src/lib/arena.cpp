@@ -0,0 +1,57 @@
+#include "arena.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+namespace
+{
+// Most trees need a handful of these; a bigger request gets a block of its own.
+const size_t blockSize = 256 * 1024;
+}
+
+Arena::~Arena()
+{
+    for (auto &block : blocks)
+    {
+        free(block.first);
+    }
+}
+
+void Arena::reset()
+{
+    current = 0;
+    next = blocks.empty() ? nullptr : blocks[0].first;
+    limit = blocks.empty() ? nullptr : blocks[0].first + blocks[0].second;
+}
+
+void *Arena::refill(size_t bytes, size_t alignment)
+{
+    size_t needed = bytes + alignment;
+    // after a reset, move on to the next kept block that is big enough
+    size_t block = blocks.empty() ? 0 : current + 1;
+    while (block < blocks.size() && blocks[block].second < needed)
+    {
+        block++;
+    }
+    if (block == blocks.size())
+    {
+        size_t size = max(blockSize, needed);
+        char *start = static_cast<char *>(malloc(size));
+        if (start == nullptr)
+        {
+            throw bad_alloc();
+        }
+        blocks.emplace_back(start, size);
+    }
+    current = block;
+    next = blocks[block].first;
+    limit = next + blocks[block].second;
+    return bump(bytes, alignment);
+}
+
+Arena &nodeArena()
+{
+    thread_local Arena arena;
+    return arena;
+}
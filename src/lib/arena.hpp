@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Bump allocator for syntax tree nodes. Allocating advances a pointer through
+// large blocks and freeing does nothing, so a whole tree goes at once when its
+// arena is reset or destroyed, without visiting the nodes or running their
+// destructors. It is a memory_resource so that the nodes' pmr vectors keep
+// their elements in the arena as well; nothing in a node may own memory
+// outside it.
+class Arena : public pmr::memory_resource
+{
+public:
+    Arena() = default;
+    ~Arena();
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    // Default-constructs a T in the arena.
+    template <typename T>
+    T *make()
+    {
+        return new (bump(sizeof(T), alignof(T))) T();
+    }
+
+    // Forgets everything allocated so far, keeping the blocks for reuse.
+    void reset();
+
+private:
+    void *bump(size_t bytes, size_t alignment)
+    {
+        uintptr_t start = (uintptr_t(next) + alignment - 1) & ~uintptr_t(alignment - 1);
+        if (start + bytes > uintptr_t(limit))
+        {
+            return refill(bytes, alignment);
+        }
+        next = reinterpret_cast<char *>(start + bytes);
+        return reinterpret_cast<void *>(start);
+    }
+    void *refill(size_t bytes, size_t alignment);
+
+    void *do_allocate(size_t bytes, size_t alignment) override { return bump(bytes, alignment); }
+    void do_deallocate(void *, size_t, size_t) override {}
+    bool do_is_equal(const pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+    vector<pair<char *, size_t>> blocks; // start and size of each block
+    size_t current{0}; // block being bumped through, if any
+    char *next{nullptr};
+    char *limit{nullptr};
+};
+
+// The calling thread's node arena, which the calc parser allocates every node in.
+Arena &nodeArena();
+
+// A vector for use inside nodes, which keeps its elements in the node arena of
+// the thread that made it.
+template <typename T>
+struct ArenaVector : pmr::vector<T>
+{
+    ArenaVector() : pmr::vector<T>(&nodeArena()) {}
+};
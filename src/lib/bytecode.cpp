@@ -0,0 +1,406 @@
+#include "bytecode.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace
+{
+// Compiles the nodes of one chunk.
+class Compiler
+{
+public:
+    Compiler() : tree(syntaxTree()) {}
+
+    // The chunk's slot for symbol, added the first time it is used.
+    uint32_t slot(int symbol);
+
+    // Compiles a statement, leaving nothing on the stack.
+    void statement(NodeIndex node);
+    void block(NodeIndex block);
+    // Compiles an expression, leaving its value on the stack, and returns
+    // whether that is always a number.
+    bool expression(NodeIndex node);
+
+    size_t emit(OpCode op, uint32_t a = 0, uint32_t b = 0);
+    // The chunk compiled, with bySymbol filled in.
+    Chunk take();
+
+    Chunk chunk;
+
+private:
+    uint32_t here() const { return uint32_t(chunk.code.size()); }
+    // Points the jump at position at to the next instruction.
+    void patch(size_t at) { chunk.code[at].a = here(); }
+
+    bool binary(NodeIndex node);
+    bool assignment(NodeIndex node, bool keep);
+    void element(NodeIndex node);
+    bool call(NodeIndex node);
+
+    const FlatTree &tree;
+    // the slot of each symbol the chunk uses
+    unordered_map<int, uint32_t> slots;
+};
+
+bool isIdentifier(const FlatTree &tree, NodeIndex node)
+{
+    return node != noNode && tree[node].kind == NodeKind::IDENTIFIER;
+}
+
+uint32_t Compiler::slot(int symbol)
+{
+    auto found = slots.find(symbol);
+    if (found != slots.end())
+    {
+        return found->second;
+    }
+    chunk.names.push_back(symbol);
+    return slots[symbol] = uint32_t(chunk.names.size() - 1);
+}
+
+size_t Compiler::emit(OpCode op, uint32_t a, uint32_t b)
+{
+    chunk.code.push_back(Instruction{op, a, b});
+    return chunk.code.size() - 1;
+}
+
+Chunk Compiler::take()
+{
+    for (uint32_t slot = 0; slot < chunk.names.size(); slot++)
+    {
+        chunk.bySymbol.push_back(slot);
+    }
+    sort(chunk.bySymbol.begin(), chunk.bySymbol.end(),
+         [&](uint32_t a, uint32_t b) { return chunk.names[a] < chunk.names[b]; });
+    return move(chunk);
+}
+
+void Compiler::statement(NodeIndex node)
+{
+    if (node == noNode)
+    {
+        return;
+    }
+    FlatNode current = tree[node];
+    switch (current.kind)
+    {
+    case NodeKind::IF_ELSE:
+    {
+        expression(tree.child(node, 0));
+        size_t toElse = emit(OpCode::BRANCH_FALSE);
+        block(tree.child(node, 1));
+        // only an if with an else has a third child
+        if (current.count == 3)
+        {
+            size_t toEnd = emit(OpCode::JUMP);
+            patch(toElse);
+            block(tree.child(node, 2));
+            patch(toEnd);
+        }
+        else
+        {
+            patch(toElse);
+        }
+        break;
+    }
+    case NodeKind::WHILE:
+    {
+        uint32_t start = here();
+        expression(tree.child(node, 0));
+        size_t toEnd = emit(OpCode::BRANCH_FALSE);
+        block(tree.child(node, 1));
+        emit(OpCode::JUMP, start);
+        patch(toEnd);
+        break;
+    }
+    case NodeKind::PRINT:
+        expression(tree.child(node, 0));
+        emit(OpCode::PRINT);
+        break;
+    case NodeKind::RETURN:
+        emit(OpCode::CHECK_RETURN);
+        // a bare return is allowed but returns nothing
+        if (current.count > 0)
+        {
+            expression(tree.child(node, 0));
+            emit(OpCode::SET_RETURN);
+        }
+        break;
+    case NodeKind::FUNCTION_DEF:
+        emit(OpCode::DEFINE, node, slot(current.symbol));
+        break;
+    case NodeKind::BINARY:
+        if (current.op == TokenKind::ASSIGN)
+        {
+            assignment(node, false);
+            break;
+        }
+        expression(node);
+        emit(OpCode::POP);
+        break;
+    case NodeKind::BLOCK:
+    case NodeKind::PARAMETER:
+    case NodeKind::UNPARSED_BODY:
+        emit(OpCode::UNEXPECTED_NODE, node);
+        break;
+    default:
+        expression(node);
+        emit(OpCode::POP);
+        break;
+    }
+}
+
+void Compiler::block(NodeIndex block)
+{
+    for (uint32_t i = 0; i < tree[block].count; i++)
+    {
+        statement(tree.child(block, i));
+    }
+}
+
+bool Compiler::expression(NodeIndex node)
+{
+    if (node == noNode)
+    {
+        emit(OpCode::PUSH_NAN);
+        return true;
+    }
+    FlatNode current = tree[node];
+    switch (current.kind)
+    {
+    case NodeKind::NUMBER:
+        if (isnan(current.number))
+        {
+            // stod throws for some literals, which has to happen when reached
+            emit(OpCode::PUSH_LITERAL, node);
+        }
+        else
+        {
+            uint64_t bits;
+            memcpy(&bits, &current.number, sizeof(bits));
+            emit(OpCode::PUSH_NUMBER, uint32_t(bits), uint32_t(bits >> 32));
+        }
+        return true;
+    case NodeKind::BOOLEAN:
+        emit(current.boolean ? OpCode::PUSH_TRUE : OpCode::PUSH_FALSE);
+        return false;
+    case NodeKind::NULL_VALUE:
+        emit(OpCode::PUSH_NULL);
+        return false;
+    case NodeKind::IDENTIFIER:
+        emit(OpCode::LOAD, slot(current.symbol), node);
+        return false;
+    case NodeKind::BINARY:
+        return binary(node);
+    case NodeKind::ARRAY_LITERAL:
+        for (uint32_t i = 0; i < current.count; i++)
+        {
+            expression(tree.child(node, i));
+        }
+        emit(OpCode::MAKE_ARRAY, current.count);
+        return false;
+    case NodeKind::ARRAY_INDEX:
+        element(node);
+        return false;
+    case NodeKind::FUNCTION_CALL:
+        return call(node);
+    default:
+        // a statement, which has no value
+        emit(OpCode::UNEXPECTED_NODE, node);
+        return false;
+    }
+}
+
+bool Compiler::binary(NodeIndex node)
+{
+    TokenKind op = tree[node].op;
+    NodeIndex left = tree.child(node, 0);
+    NodeIndex right = tree.child(node, 1);
+    OpCode fused;
+    switch (op)
+    {
+    case TokenKind::ASSIGN:
+        return assignment(node, true);
+    case TokenKind::PLUS:
+        fused = OpCode::ADD;
+        break;
+    case TokenKind::MINUS:
+        fused = OpCode::SUBTRACT;
+        break;
+    case TokenKind::STAR:
+        fused = OpCode::MULTIPLY;
+        break;
+    case TokenKind::SLASH:
+        fused = OpCode::DIVIDE;
+        break;
+    case TokenKind::PERCENT:
+        fused = OpCode::MODULO;
+        break;
+    case TokenKind::EQ:
+        fused = OpCode::EQUAL;
+        break;
+    case TokenKind::NE:
+        fused = OpCode::NOT_EQUAL;
+        break;
+    case TokenKind::LT:
+        fused = OpCode::LESS;
+        break;
+    case TokenKind::LE:
+        fused = OpCode::LESS_EQUAL;
+        break;
+    case TokenKind::GT:
+        fused = OpCode::GREATER;
+        break;
+    case TokenKind::GE:
+        fused = OpCode::GREATER_EQUAL;
+        break;
+    case TokenKind::AND:
+        fused = OpCode::AND;
+        break;
+    case TokenKind::OR:
+        fused = OpCode::OR;
+        break;
+    default:
+        fused = OpCode::XOR;
+        break;
+    }
+    bool arithmetic = fused >= OpCode::ADD && fused <= OpCode::MODULO;
+
+    // arithmetic checks its left operand before evaluating the right one
+    if (!expression(left) && arithmetic)
+    {
+        emit(OpCode::CHECK_NOT_BOOL);
+    }
+    if (op == TokenKind::AND || op == TokenKind::OR)
+    {
+        // false & and true | are decided without the right operand
+        size_t toEnd = emit(OpCode::KEEP_IF, 0, op == TokenKind::OR);
+        expression(right);
+        emit(fused);
+        patch(toEnd);
+        return false;
+    }
+    expression(right);
+    emit(fused);
+    return arithmetic;
+}
+
+// The value is evaluated first and the assignee after it.
+bool Compiler::assignment(NodeIndex node, bool keep)
+{
+    NodeIndex target = tree.child(node, 0);
+    bool number = expression(tree.child(node, 1));
+    if (isIdentifier(tree, target))
+    {
+        if (chunk.topLevel)
+        {
+            emit(keep ? OpCode::STORE_GLOBAL : OpCode::STORE_GLOBAL_POP, slot(tree[target].symbol));
+        }
+        else
+        {
+            emit(keep ? OpCode::STORE : OpCode::STORE_POP, slot(tree[target].symbol));
+        }
+        return number;
+    }
+    if (target == noNode || tree[target].kind != NodeKind::ARRAY_INDEX)
+    {
+        emit(OpCode::INVALID_ASSIGNEE);
+        return number;
+    }
+    expression(tree.child(target, 1));
+    emit(OpCode::CHECK_INDEX);
+    expression(tree.child(target, 0));
+    emit(OpCode::SET_ELEMENT);
+    if (!keep)
+    {
+        emit(OpCode::POP);
+    }
+    return number;
+}
+
+// The index is evaluated and checked before the array is evaluated.
+void Compiler::element(NodeIndex node)
+{
+    NodeIndex array = tree.child(node, 0);
+    expression(tree.child(node, 1));
+    if (isIdentifier(tree, array))
+    {
+        emit(OpCode::LOAD_ELEMENT, slot(tree[array].symbol), array);
+        return;
+    }
+    emit(OpCode::CHECK_INDEX);
+    expression(array);
+    emit(OpCode::GET_ELEMENT);
+}
+
+bool Compiler::call(NodeIndex node)
+{
+    FlatNode current = tree[node];
+    string_view name = tree.token(node).text;
+    if (name == "len" || name == "push" || name == "pop")
+    {
+        // these are called by name, whatever a variable of that name holds
+        if (current.count != (name == "push" ? 2u : 1u))
+        {
+            emit(OpCode::BAD_ARGUMENT_COUNT);
+            return false;
+        }
+        for (uint32_t i = 0; i < current.count; i++)
+        {
+            expression(tree.child(node, i));
+        }
+        emit(name == "len" ? OpCode::ARRAY_LENGTH : name == "push" ? OpCode::ARRAY_PUSH : OpCode::ARRAY_POP);
+        return name == "len";
+    }
+    // the function is looked up and checked before its arguments are evaluated
+    emit(OpCode::PREPARE_CALL, slot(current.symbol), current.count);
+    for (uint32_t i = 0; i < current.count; i++)
+    {
+        expression(tree.child(node, i));
+    }
+    emit(OpCode::CALL, current.count);
+    return false;
+}
+}
+
+Chunk compileProgram(const vector<NodeIndex> &statements)
+{
+    Compiler compiler;
+    compiler.chunk.topLevel = true;
+    for (NodeIndex statement : statements)
+    {
+        compiler.emit(OpCode::BEGIN_STATEMENT);
+        compiler.statement(statement);
+    }
+    compiler.emit(OpCode::HALT);
+    return compiler.take();
+}
+
+Chunk compileFunction(NodeIndex def)
+{
+    NodeIndex body = functionBody(def);
+    Compiler compiler;
+    const FlatTree &tree = syntaxTree();
+    NodeIndex parameters = tree.child(def, 0);
+    for (uint32_t i = 0; i < tree[parameters].count; i++)
+    {
+        compiler.chunk.parameters.push_back(compiler.slot(tree[tree.child(parameters, i)].symbol));
+    }
+    compiler.chunk.parameterSlots = compiler.chunk.names.size();
+    // a return only takes effect once the body statement it is in finishes
+    for (uint32_t i = 0; i < tree[body].count; i++)
+    {
+        compiler.statement(tree.child(body, i));
+        compiler.emit(OpCode::RETURN_IF_SET);
+    }
+    compiler.emit(OpCode::END_FUNCTION);
+    return compiler.take();
+}
+
+uint32_t slotOf(const Chunk &chunk, int symbol)
+{
+    auto found = lower_bound(chunk.bySymbol.begin(), chunk.bySymbol.end(), symbol,
+                             [&](uint32_t slot, int wanted) { return chunk.names[slot] < wanted; });
+    return found != chunk.bySymbol.end() && chunk.names[*found] == symbol ? *found : noSlot;
+}
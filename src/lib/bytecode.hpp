@@ -0,0 +1,112 @@
+#pragma once
+#include "statements.hpp"
+
+// The instructions scrypt code is compiled to, for a machine that keeps its
+// operands on a stack. Each one names what it pops and pushes; an operator
+// pops its right operand first. Every operand is evaluated once, left to
+// right, except that & and | skip their right operand when the left one
+// decides the result.
+enum class OpCode : uint8_t
+{
+    // values
+    PUSH_NUMBER,       // a, b: the low and high halves of the number's bits
+    PUSH_LITERAL,      // a: a NUMBER node whose value only stod can decode
+    PUSH_TRUE,
+    PUSH_FALSE,
+    PUSH_NULL,
+    PUSH_NAN,          // what an operand the parser gave up on evaluates to
+    POP,
+
+    // variables, by slot
+    LOAD,              // a: slot, b: its IDENTIFIER node, for an unknown name
+    STORE,             // a: slot; the value stays on the stack
+    STORE_POP,         // a: slot
+    STORE_GLOBAL,      // as STORE, at the top level
+    STORE_GLOBAL_POP,  // as STORE_POP, at the top level
+
+    // arrays
+    MAKE_ARRAY,        // a: element count; elements -> array
+    CHECK_INDEX,       // the index on top has to be an integer
+    GET_ELEMENT,       // index, array -> element
+    LOAD_ELEMENT,      // a, b: as for LOAD; index -> element of the variable
+    SET_ELEMENT,       // value, index, array -> value
+    ARRAY_LENGTH,      // array -> length
+    ARRAY_PUSH,        // array, value -> null
+    ARRAY_POP,         // array -> last element
+
+    // operators
+    CHECK_NOT_BOOL,    // the left operand of arithmetic, before the right
+    KEEP_IF,           // a: target, b: bool; jumps if the left operand on top
+                       // is the bool b, which is then the result
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    MODULO,
+    EQUAL,
+    NOT_EQUAL,
+    LESS,
+    LESS_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    AND,
+    OR,
+    XOR,
+
+    // control
+    JUMP,              // a: target
+    BRANCH_FALSE,      // a: target; pops a condition that has to be a bool
+    HALT,
+
+    // statements
+    PRINT,
+    DEFINE,            // a: the FUNCTION_DEF node, b: the slot of its name
+    BEGIN_STATEMENT,   // each top-level statement starts outside any function
+    CHECK_RETURN,      // a return is only allowed inside a function
+    SET_RETURN,        // pops the value returned
+    RETURN_IF_SET,     // after each statement of a function's body
+    END_FUNCTION,      // falling off the end of a body returns null
+
+    // calls
+    PREPARE_CALL,      // a: slot, b: argument count; -> function
+    CALL,              // a: argument count; function, arguments -> result
+
+    // errors found while compiling, raised when reached
+    INVALID_ASSIGNEE,
+    BAD_ARGUMENT_COUNT,
+    UNEXPECTED_NODE    // a: a statement node where an expression has to be
+};
+
+// One instruction, with the operands its opcode describes.
+struct Instruction
+{
+    OpCode op;
+    uint32_t a{0};
+    uint32_t b{0};
+};
+
+// The code of a program's top level or of one function's body, with a slot
+// for each name the code uses, numbered from 0 in the order they turn up,
+// a function's parameters first. Jumps target positions in the same chunk.
+struct Chunk
+{
+    vector<Instruction> code;
+    vector<uint32_t> parameters;         // slots of a function's parameters, in order
+    size_t parameterSlots{0};            // how many slots they take, which come first
+    vector<int> names;                   // the symbol of each slot
+    vector<uint32_t> bySymbol;           // the slots in the order of their symbols
+    bool topLevel{false};
+};
+
+// The slot of a name a chunk does not use.
+const uint32_t noSlot = UINT32_MAX;
+
+// The slot of symbol in chunk, or noSlot if the chunk does not use the name.
+uint32_t slotOf(const Chunk &chunk, int symbol);
+
+// Compiles the top-level statements of a program, in order, ending in HALT.
+Chunk compileProgram(const vector<NodeIndex> &statements);
+
+// Compiles the body of the function defined at def, parsing it first if it
+// was left unparsed, which reports any syntax error in it.
+Chunk compileFunction(NodeIndex def);
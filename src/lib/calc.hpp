@@ -1,52 +1,65 @@
 #include "lex.hpp"
+#include "arena.hpp"
+#include "precedence.hpp"
 #include <unordered_map>
 #include <variant>
 #include <memory>
 
+// Which of the structs below a Node is. Each one sets its own kind when it is
+// constructed, so the tree walkers switch on it and static_cast instead of
+// trying one dynamic_cast after another.
+enum class CalcNodeKind : uint8_t
+{
+    EXPRESSION, // a plain Node
+    ARRAY_LITERAL,
+    ARRAY_ASSIGN,
+    FUNCT_DEF,
+    FUNCT_CALL,
+    RETURN
+};
+
 struct Node
 {
+    CalcNodeKind kind{CalcNodeKind::EXPRESSION};
+    // only expression nodes set this; the subclasses leave it WHITESPACE,
+    // which the formatter relies on to tell them apart
     Token token;
-    vector<Node *> children;
-    virtual ~Node() = default;
+    ArenaVector<Node *> children;
 };
 
 struct ArrayLiteralNode : public Node
 {
-    Token token;
-    vector<Node *> array;
-    virtual ~ArrayLiteralNode() = default;
+    ArenaVector<Node *> array;
+    ArrayLiteralNode() { kind = CalcNodeKind::ARRAY_LITERAL; }
 };
 
 struct ArrayAssignNode : public Node
 {
-    Token token;
     Node *expression;
     Node *arrayIndex;
-    virtual ~ArrayAssignNode() = default;
+    ArrayAssignNode() { kind = CalcNodeKind::ARRAY_ASSIGN; }
 };
 
 struct FunctDefNode : public Node
 {
-    Token token;
     Token functname;
-    unordered_map<string, variant<double, bool>> vars;
-    vector<string> params;
-    vector<Node *> statements;
-    virtual ~FunctDefNode() = default;
+    ArenaVector<string_view> params; // views into the source, like token texts
+    ArenaVector<int> paramSymbols;
+    ArenaVector<Node *> statements;
+    FunctDefNode() { kind = CalcNodeKind::FUNCT_DEF; }
 };
 
 struct FunctCallNode : public Node
 {
     Token functname;
-    vector<Node *> arguments;
-    virtual ~FunctCallNode() = default;
+    ArenaVector<Node *> arguments;
+    FunctCallNode() { kind = CalcNodeKind::FUNCT_CALL; }
 };
 
 struct ReturnNode : public Node
 {
-    Token token;
     Node* expression;
-    virtual ~ReturnNode() = default;
+    ReturnNode() { kind = CalcNodeKind::RETURN; }
 };
 
 class Function;
@@ -61,56 +74,75 @@ struct Value : public variant<
 };
 
 
+// std::variant's relational operators do not compile for the nullptr_t
+// alternative, so Values are ordered by alternative first and then by the
+// held value, with null comparing equal to null.
+inline bool operator<(const Value &lhs, const Value &rhs)
+{
+    if (lhs.index() != rhs.index())
+    {
+        return lhs.index() < rhs.index();
+    }
+    switch (lhs.index())
+    {
+    case 0:
+        return get<0>(lhs) < get<0>(rhs);
+    case 1:
+        return get<1>(lhs) < get<1>(rhs);
+    case 3:
+        return get<3>(lhs) < get<3>(rhs);
+    case 4:
+        return get<4>(lhs) < get<4>(rhs);
+    default:
+        return false;
+    }
+}
+inline bool operator>(const Value &lhs, const Value &rhs) { return rhs < lhs; }
+inline bool operator<=(const Value &lhs, const Value &rhs) { return !(rhs < lhs); }
+inline bool operator>=(const Value &lhs, const Value &rhs) { return !(lhs < rhs); }
+
 class Function {
     public:
         FunctDefNode *function;
-        unordered_map<string, Value> functVariables;
+        unordered_map<int, Value> functVariables;
 };
 
 
 Node *makeNodeCalc(const Token &token);
 
-ArrayLiteralNode *makeArrayLiteralNodeCalc(const Token &token);
-ArrayAssignNode *makeArrayAssignNodeCalc(const Token &token);
+ArrayLiteralNode *makeArrayLiteralNodeCalc();
+ArrayAssignNode *makeArrayAssignNodeCalc();
 FunctCallNode *makeFunctCallNodeCalc(const Token &token);
 
-bool checkIdenCalc(Node *root, unordered_map<string, Value> &variables, bool &error);
+bool checkIdenCalc(Node *root, unordered_map<int, Value> &variables, bool &error);
 bool checkVarCalc(Node *root, bool &error);
 bool checkParenCalc(vector<Token> &tokens, bool &error);
 
 Node *parseExpressionCalc(const vector<Token> &tokens, int &index, bool &error);
 
 Node *parseAssignmentCalc(const std::vector<Token> &tokens, int &index, bool &error);
-Node *parseComparisonCalc(const std::vector<Token> &tokens, int &index, bool &error);
-Node *parseLogicAndCalc(const std::vector<Token> &tokens, int &index, bool &error);
-Node *parseLogicXorCalc(const std::vector<Token> &tokens, int &index, bool &error);
-Node *parseLogicOrCalc(const std::vector<Token> &tokens, int &index, bool &error);
-Node *parseEqualityCalc(const std::vector<Token> &tokens, int &index, bool &error);
-Node *parseAddSubCalc(const std::vector<Token> &tokens, int &index, bool &error);
-Node *parseMultDivModCalc(const std::vector<Token> &tokens, int &index, bool &error);
+Node *parseBinaryCalc(const std::vector<Token> &tokens, int &index, Precedence minimum, bool &error);
 Node *parsePrimaryCalc(const std::vector<Token> &tokens, int &index, bool &error);
 
 ArrayLiteralNode *parseArrayLiteralCalc(const std::vector<Token> &tokens, int &index, bool &error);
 ArrayAssignNode *parseArrayAssignCalc(const std::vector<Token> &tokens, int &index, bool &error);
 
-bool matchCalc(const std::vector<Token> &tokens, int index, string expectedType);
+bool matchCalc(const std::vector<Token> &tokens, int index, TokenKind expected);
 Node *makeTreeCalc(const vector<Token> &tokens, int &index, bool &error);
-void deleteNodeCalc(Node *node);
-void deleteNodeAllCalc(Node *node);
 
 void printInfixCalc(Node *node);
 void printInfixHelperCalc(Node *node);
 
 void printErrorCalc(const Token &token, bool &error);
 
-Value evaluateAllCalc(Node *node, unordered_map<string, Value> &variables, bool &error, bool &inFunct);
-Value evaluateExpressionCalc(Node* root, unordered_map<string, Value> &variables, bool &error, bool &inFunct);
-Value evaluateFunctDefCalc(FunctDefNode* root, unordered_map<string, Value> &variables, bool &error, bool &inFunct);
-Value evaluateFunctCallCalc(FunctCallNode* root, unordered_map<string, Value> &variables, bool &error, bool &inFunct);
-Value evaluateReturnCalc(ReturnNode* root, unordered_map<string, Value> &variables, bool &error, bool &inFunct);
-Value evaluateArrayLiteralCalc(ArrayLiteralNode* root, unordered_map<string, Value> &variables, bool &error, bool &inFunct);
-Value evaluateArrayAssignCalc(ArrayAssignNode* root, unordered_map<string, Value> &variables, bool &error, bool &inFunct, bool setValue);
-Value evaluateUtilityFunctCalc(FunctCallNode* root, unordered_map<string, Value> &variables, bool &error, bool &inFunct);
+Value evaluateAllCalc(Node *node, unordered_map<int, Value> &variables, bool &error, bool &inFunct);
+Value evaluateExpressionCalc(Node* root, unordered_map<int, Value> &variables, bool &error, bool &inFunct);
+Value evaluateFunctDefCalc(FunctDefNode* root, unordered_map<int, Value> &variables, bool &error, bool &inFunct);
+Value evaluateFunctCallCalc(FunctCallNode* root, unordered_map<int, Value> &variables, bool &error, bool &inFunct);
+Value evaluateReturnCalc(ReturnNode* root, unordered_map<int, Value> &variables, bool &error, bool &inFunct);
+Value evaluateArrayLiteralCalc(ArrayLiteralNode* root, unordered_map<int, Value> &variables, bool &error, bool &inFunct);
+Value evaluateArrayAssignCalc(ArrayAssignNode* root, unordered_map<int, Value> &variables, bool &error, bool &inFunct, bool setValue);
+Value evaluateUtilityFunctCalc(FunctCallNode* root, unordered_map<int, Value> &variables, bool &error, bool &inFunct);
 
 void printValueCalc(Value value);
 Value lenCalc(Value array, bool &error);
@@ -0,0 +1,224 @@
+#include "flat_tree.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace
+{
+bool shareable(NodeKind kind)
+{
+    return kind != NodeKind::FUNCTION_DEF && kind != NodeKind::PARAMETER && kind != NodeKind::UNPARSED_BODY;
+}
+
+uint64_t mix(uint64_t hash, uint64_t value)
+{
+    hash = (hash ^ value) * 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 29);
+}
+
+// Hash of a node with the given children; equal nodes hash the same.
+uint64_t hashNode(const FlatNode &node, string_view text, const NodeIndex *first)
+{
+    uint64_t payload;
+    memcpy(&payload, &node.number, sizeof(payload));
+    uint64_t hash = mix(uint64_t(node.kind) << 8 | uint64_t(node.op), payload);
+    for (char c : text)
+    {
+        hash = mix(hash, uint8_t(c));
+    }
+    hash = mix(hash, node.count);
+    for (uint32_t i = 0; i < node.count; i++)
+    {
+        hash = mix(hash, first[i]);
+    }
+    return hash;
+}
+
+// The text that sets a node apart from others of its kind beyond its payload:
+// a number literal prints as written.
+string_view distinctText(const FlatNode &node, const Token &token)
+{
+    return node.kind == NodeKind::NUMBER ? token.text : string_view();
+}
+}
+
+void FlatTree::reset(TokenSpan program)
+{
+    nodes.clear();
+    children.clear();
+    pending.clear();
+    this->program = program;
+    setSharing(sharing);
+}
+
+void FlatTree::setSharing(bool on)
+{
+    sharing = on;
+    shared.clear();
+    sharedCount = 0;
+    if (sharing)
+    {
+        growShared();
+    }
+}
+
+NodeIndex FlatTree::add(NodeKind kind, const Token &token, initializer_list<NodeIndex> children)
+{
+    return append(kind, token, children.begin(), children.size());
+}
+
+NodeIndex FlatTree::close(size_t list, NodeKind kind, const Token &token)
+{
+    NodeIndex node = append(kind, token, pending.data() + list, pending.size() - list);
+    pending.resize(list);
+    return node;
+}
+
+vector<NodeIndex> FlatTree::merge(const FlatTree &other)
+{
+    vector<NodeIndex> positions(other.nodes.size());
+    if (sharing)
+    {
+        // add the nodes one at a time, children first as they were parsed, so
+        // that each is shared with an equal node already here
+        vector<NodeIndex> nodeChildren;
+        for (size_t i = 0; i < other.nodes.size(); i++)
+        {
+            const FlatNode &node = other.nodes[i];
+            nodeChildren.clear();
+            for (uint32_t c = 0; c < node.count; c++)
+            {
+                NodeIndex child = other.children[node.first + c];
+                nodeChildren.push_back(child == noNode ? noNode : positions[child]);
+            }
+            positions[i] = store(node, nodeChildren.data());
+        }
+        return positions;
+    }
+
+    NodeIndex nodeOffset = NodeIndex(nodes.size());
+    uint32_t childOffset = uint32_t(children.size());
+    nodes.reserve(nodes.size() + other.nodes.size());
+    for (FlatNode node : other.nodes)
+    {
+        node.first += childOffset;
+        nodes.push_back(node);
+    }
+    children.reserve(children.size() + other.children.size());
+    for (NodeIndex child : other.children)
+    {
+        children.push_back(child == noNode ? noNode : child + nodeOffset);
+    }
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        positions[i] = nodeOffset + NodeIndex(i);
+    }
+    return positions;
+}
+
+NodeIndex FlatTree::append(NodeKind kind, const Token &token, const NodeIndex *first, size_t count)
+{
+    FlatNode node;
+    node.kind = kind;
+    node.token = uint32_t(&token - program.begin());
+    node.first = uint32_t(children.size());
+    node.count = uint32_t(count);
+    switch (kind)
+    {
+    case NodeKind::NUMBER:
+        node.number = token.number;
+        break;
+    case NodeKind::BOOLEAN:
+        node.boolean = token.kind == TokenKind::KW_TRUE;
+        break;
+    case NodeKind::IDENTIFIER:
+    case NodeKind::FUNCTION_CALL:
+    case NodeKind::FUNCTION_DEF:
+    case NodeKind::PARAMETER:
+        node.symbol = token.symbol;
+        break;
+    case NodeKind::BINARY:
+        node.op = token.kind;
+        break;
+    default:
+        break;
+    }
+    return store(node, first);
+}
+
+NodeIndex FlatTree::store(FlatNode node, const NodeIndex *first)
+{
+    size_t slot = 0;
+    uint32_t hash = 0;
+    bool share = sharing && shareable(node.kind);
+    if (share)
+    {
+        NodeIndex existing = findShared(node, first, slot, hash);
+        if (existing != noNode)
+        {
+            return existing;
+        }
+    }
+    node.first = uint32_t(children.size());
+    children.insert(children.end(), first, first + node.count);
+    nodes.push_back(node);
+    NodeIndex added = NodeIndex(nodes.size() - 1);
+    if (share)
+    {
+        shared[slot] = SharedSlot{added, hash};
+        if (++sharedCount * 2 > shared.size())
+        {
+            growShared();
+        }
+    }
+    return added;
+}
+
+NodeIndex FlatTree::findShared(const FlatNode &node, const NodeIndex *first, size_t &slot, uint32_t &hash) const
+{
+    string_view text = distinctText(node, program[node.token]);
+    hash = uint32_t(hashNode(node, text, first));
+    size_t mask = shared.size() - 1;
+    for (slot = hash & mask; shared[slot].node != noNode; slot = (slot + 1) & mask)
+    {
+        if (shared[slot].hash != hash)
+        {
+            continue;
+        }
+        const FlatNode &other = nodes[shared[slot].node];
+        if (other.kind == node.kind && other.op == node.op && other.count == node.count &&
+            memcmp(&other.number, &node.number, sizeof(node.number)) == 0 &&
+            distinctText(other, program[other.token]) == text &&
+            equal(first, first + node.count, children.begin() + other.first))
+        {
+            return shared[slot].node;
+        }
+    }
+    return noNode;
+}
+
+void FlatTree::growShared()
+{
+    vector<SharedSlot> old = move(shared);
+    shared.assign(max<size_t>(old.size() * 2, 1024), SharedSlot{noNode, 0});
+    size_t mask = shared.size() - 1;
+    for (const SharedSlot &entry : old)
+    {
+        if (entry.node != noNode)
+        {
+            size_t slot = entry.hash & mask;
+            while (shared[slot].node != noNode)
+            {
+                slot = (slot + 1) & mask;
+            }
+            shared[slot] = entry;
+        }
+    }
+}
+
+FlatTree &syntaxTree()
+{
+    thread_local FlatTree tree;
+    return tree;
+}
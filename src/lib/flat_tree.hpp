@@ -0,0 +1,128 @@
+#pragma once
+#include "lex.hpp"
+#include <initializer_list>
+
+// What a node of a FlatTree is, and so what its payload and children hold.
+enum class NodeKind : uint8_t
+{
+    NUMBER,        // number: the literal's value, NaN if it has to go through stod
+    BOOLEAN,       // boolean: the literal's value
+    NULL_VALUE,
+    IDENTIFIER,    // symbol: the name
+    BINARY,        // op: the operator, = included; children: the two operands
+    ARRAY_LITERAL, // children: the elements
+    ARRAY_INDEX,   // children: the array and the index
+    FUNCTION_CALL, // symbol: the function's name; children: the arguments
+    IF_ELSE,       // children: the condition, the then block and any else block
+    WHILE,         // children: the condition and the body block
+    PRINT,         // children: the expression
+    RETURN,        // children: the expression, if there is one
+    FUNCTION_DEF,  // symbol: the name; children: the parameter and body blocks
+    PARAMETER,     // symbol: the name
+    BLOCK,         // children: the statements or parameters, in order
+    UNPARSED_BODY  // token: the { of a function body left for functionBody to parse
+};
+
+// Position of a node in its FlatTree.
+using NodeIndex = uint32_t;
+
+// Stands in for an operand the parser gave up on without reporting an error.
+const NodeIndex noNode = UINT32_MAX;
+
+// One node of a FlatTree, in 24 bytes.
+struct FlatNode
+{
+    NodeKind kind;
+    TokenKind op{TokenKind::NONE};
+    uint32_t token{0}; // position of the token it was parsed from, for its text
+    uint32_t first{0}; // its children are the tree's children[first, first + count)
+    uint32_t count{0};
+    union
+    {
+        double number{0};
+        bool boolean;
+        int symbol;
+    };
+};
+
+// Syntax trees kept in a few contiguous arrays instead of as nodes linked by
+// pointers. Nodes are added children first, each node's children are listed
+// next to each other by 32-bit position, and literals and names are decoded
+// into the nodes, so a walk over a tree reads memory mostly in order and never
+// follows a pointer. All the trees parsed from one program share a FlatTree.
+class FlatTree
+{
+public:
+    // Empties the tree for parsing a run of tokens, which has to outlive it.
+    void reset(TokenSpan program);
+
+    // With sharing on, adding a node equal to one already in the tree, with
+    // the same kind, operator, payload, literal text and children, gives back
+    // that node instead of a copy, so repeated subtrees are stored once.
+    // Function definitions, whose bodies can be filled in late, and their
+    // parameters are never shared, and neither is any node's position in the
+    // source, so a shared node's token is that of its first occurrence.
+    void setSharing(bool on);
+
+    const FlatNode &operator[](NodeIndex node) const { return nodes[node]; }
+    // The ith child of node, or noNode.
+    NodeIndex child(NodeIndex node, uint32_t i) const { return children[nodes[node].first + i]; }
+    const NodeIndex *childrenBegin(NodeIndex node) const { return children.data() + nodes[node].first; }
+    const NodeIndex *childrenEnd(NodeIndex node) const { return childrenBegin(node) + nodes[node].count; }
+    // The token node was parsed from.
+    const Token &token(NodeIndex node) const { return program[nodes[node].token]; }
+    // The value of a NUMBER node.
+    double number(NodeIndex node) const
+    {
+        return isnan(nodes[node].number) ? numberValue(token(node)) : nodes[node].number;
+    }
+    size_t size() const { return nodes.size(); }
+    TokenSpan tokens() const { return program; }
+
+    // Adds a node parsed from token, which has to be one of the program's,
+    // with the given children, and returns its position.
+    NodeIndex add(NodeKind kind, const Token &token, initializer_list<NodeIndex> children = {});
+
+    // Nodes with a list of children are built by opening the list, pushing
+    // the children as they are parsed and closing it into the node.
+    size_t open() const { return pending.size(); }
+    void push(NodeIndex node) { pending.push_back(node); }
+    NodeIndex close(size_t list, NodeKind kind, const Token &token);
+
+    // Adds the nodes of other, which has to be a tree of the same program,
+    // and returns the position each now has. With sharing on, a node equal to
+    // one already here is shared with it, as if it had been parsed here.
+    vector<NodeIndex> merge(const FlatTree &other);
+
+    // Makes child the ith child of node, for filling in a part parsed late.
+    void setChild(NodeIndex node, uint32_t i, NodeIndex child) { children[nodes[node].first + i] = child; }
+
+private:
+    NodeIndex append(NodeKind kind, const Token &token, const NodeIndex *first, size_t count);
+    // Adds node, whose children are the node.count positions at first, or
+    // gives back an equal node to share instead.
+    NodeIndex store(FlatNode node, const NodeIndex *first);
+    // A shareable node and its hash, or noNode in an empty slot.
+    struct SharedSlot
+    {
+        NodeIndex node;
+        uint32_t hash;
+    };
+
+    // The node equal to node with the given children, or noNode, and the
+    // slot of shared it is in or would go in.
+    NodeIndex findShared(const FlatNode &node, const NodeIndex *first, size_t &slot, uint32_t &hash) const;
+    void growShared();
+
+    vector<FlatNode> nodes;
+    vector<NodeIndex> children;
+    vector<NodeIndex> pending; // children of the lists still open
+    TokenSpan program{nullptr, 0};
+    bool sharing{false};
+    // open addressed hash set of the shareable nodes
+    vector<SharedSlot> shared;
+    size_t sharedCount{0};
+};
+
+// The calling thread's tree, which the scrypt parser adds every node to.
+FlatTree &syntaxTree();
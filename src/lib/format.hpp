@@ -5,12 +5,13 @@
 #include <cmath>
 
 
-void printAll(Node *node, int &depth);
-void printInfix(Node *node, bool semi);
-void printInfixHelper(Node *node);
-void printIfElse(const Node *node, int &depth);
-void printWhile(const Node *node, int &depth);
-void printPrint(const Node *node);
-void printFunctDef(const Node *node, int &depth);
-void printReturn(const Node *node);
-void printFunctCall(const Node *node);
+void printAll(NodeIndex node, int &depth);
+void printBlock(NodeIndex block, int &depth);
+void printInfix(NodeIndex node, bool semi);
+void printInfixHelper(NodeIndex node);
+void printIfElse(NodeIndex node, int &depth);
+void printWhile(NodeIndex node, int &depth);
+void printPrint(NodeIndex node);
+void printFunctDef(NodeIndex node, int &depth);
+void printReturn(NodeIndex node);
+void printFunctCall(NodeIndex node);
@@ -1,10 +1,147 @@
+#pragma once
 #include "token.hpp"
+#include <istream>
+#include <list>
 #include <stdexcept>
 
 void finishToken(Token &currToken, vector<Token> &tokens);
 
-vector<Token> readTokens(string &input);
+// The kind spelled by the text of a token of the given type, which the lexer
+// stores in every token it makes.
+TokenKind tokenKind(TokenType type, string_view text);
 
+// Texts of tokens that a skipped \r, \v or \f splits, which cannot be a view
+// into the source. A list, so the texts of pieces lexed apart can be joined
+// without moving them.
+using SplicedTexts = list<string>;
+
+// The returned tokens view into input and into spliced, so both have to
+// outlive them.
+vector<Token> readTokens(string_view input, SplicedTexts &spliced);
+vector<Token> readTokens(string &input, SplicedTexts &spliced);
+
+// Inputs at least this large are lexed in parallel by readTokens when the
+// machine has more than one core.
+const size_t parallelLexThreshold = 1 << 20;
+
+// Lexes input on threadCount threads. The tokens and any error message are
+// the same as readTokens would give.
+vector<Token> readTokensParallel(string_view input, unsigned threadCount, SplicedTexts &spliced);
+
+// A program's source text. A regular file is mapped into memory and lexed in
+// place; stdin, pipes and other files that cannot be mapped are read in bulk.
+class SourceText
+{
+public:
+    // Maps or reads the file at path, or reads all of stdin if path is null.
+    // Exits with an error message if the input cannot be read.
+    explicit SourceText(const char *path);
+    ~SourceText();
+    SourceText(const SourceText &) = delete;
+    SourceText &operator=(const SourceText &) = delete;
+
+    string_view text() const { return string_view(data, size); }
+    // Where the tokens lexed from text() keep the texts that cannot view into it.
+    SplicedTexts &spliced() { return splicedTexts; }
+
+private:
+    // Reads fd to its end into buffer, returning false on an error.
+    bool readAll(int fd);
+
+    const char *data{nullptr};
+    size_t size{0};
+    bool mapped{false};
+    string buffer;
+    SplicedTexts splicedTexts;
+};
+
+struct SourceLocation
+{
+    int line;
+    int column;
+};
+
+// Where the lines of a source start, and where it has \r, \v or \f
+// characters, which the lexer skips without giving them a column. An index
+// kept while streaming leaves out the lines already done with, counting them
+// in firstLine instead.
+struct LineIndex
+{
+    vector<uint32_t> lineStarts;
+    vector<uint32_t> skipped;
+    int firstLine{0};
+};
+
+// The index of the input most recently lexed on the calling thread, which
+// locate reads.
+LineIndex &sourceLineIndex();
+
+// Line and column of a source offset in the input most recently lexed on the
+// calling thread. Only messages and printouts need them, so tokens keep just
+// their offset and the lexer records where lines start on the side.
+SourceLocation locate(uint32_t offset);
+
+// Identifier names are interned into a table per thread, so equal names
+// share one small integer id that can key variables instead of the string,
+// and threads can lex separate programs at once.
+int internSymbol(string_view name);
+const string &symbolName(int symbol);
+// How many names the calling thread has interned; their ids run from 0 up.
+int symbolCount();
+
+// How the calling thread reports a source that does not lex: normally the
+// message is printed, but with quiet set it is only recorded here, for a
+// caller that reports errors itself. A program rejected for a token named
+// error, which gets no message, is recorded too.
+struct LexErrors
+{
+    bool quiet{false};
+    bool found{false};
+    uint32_t offset{0}; // of the last error found
+};
+
+LexErrors &lexErrors();
+
+// Pulls tokens from a stream one chunk at a time instead of needing the whole
+// program in memory. Only complete lines are lexed, so a token cut off by the
+// end of a chunk is finished once the rest of its line has been read. Where
+// lines start is only kept for the current chunk, so locate a token before
+// pulling the next one.
+class TokenStream
+{
+public:
+    explicit TokenStream(istream &in, size_t chunkSize = 64 * 1024);
+
+    // Stores the next token and returns true, or returns false once END has
+    // been returned or the input failed to lex. The token's text is only
+    // valid until the next call.
+    bool next(Token &token);
+
+    // Whether the input failed to lex. readTokens would have returned no
+    // tokens at all, so whatever was already pulled should be discarded.
+    bool failed() const { return error; }
+
+private:
+    bool refill();
+
+    istream &in;
+    size_t chunkSize;
+    string buffer; // the lines lexed into pending and the start of the next one
+    SplicedTexts spliced; // of the tokens in pending
+    size_t lexedLength{0};
+    uint32_t bufferOffset{0}; // source offset of the start of buffer
+    vector<Token> pending;
+    size_t nextPending{0};
+    Token currToken;
+    bool finished{false};
+    bool error{false};
+    // the last two names seen, for readTokens' trailing "error" check
+    size_t tokenCount{0};
+    bool lastIsError{false};
+    bool secondLastIsError{false};
+};
+
+void printToken(ostream &out, const Token &token);
 void printTokens(vector<Token> &tokens);
 
-void LexError(vector<Token> &tokens, int lineNumber, int columnNumber);
+void LexError(vector<Token> &tokens, uint32_t offset);
@@ -3,309 +3,952 @@
 #include <iomanip>
 #include <iostream>
 #include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <limits>
+#include <deque>
+#include <thread>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
+namespace
+{
+// Words that lex as something other than an identifier.
+struct ReservedWord
+{
+    const char *text;
+    TokenType type;
+    TokenKind kind;
+};
+
+constexpr ReservedWord reservedWords[] = {
+    {"if", KEYWORD, TokenKind::KW_IF}, {"print", KEYWORD, TokenKind::KW_PRINT},
+    {"while", KEYWORD, TokenKind::KW_WHILE}, {"else", KEYWORD, TokenKind::KW_ELSE},
+    {"return", KEYWORD, TokenKind::KW_RETURN}, {"def", KEYWORD, TokenKind::KW_DEF},
+    {"true", BOOLEAN, TokenKind::KW_TRUE}, {"false", BOOLEAN, TokenKind::KW_FALSE},
+    {"null", NULLVAL, TokenKind::KW_NULL}};
+
+constexpr size_t stringLength(const char *text)
+{
+    size_t length = 0;
+    while (text[length] != '\0')
+    {
+        length++;
+    }
+    return length;
+}
+
+// Perfect hash over the reserved words: the first and last characters and
+// the length are enough to give each word its own slot.
+constexpr unsigned reservedHash(const char *text, size_t length)
+{
+    return (unsigned((unsigned char)text[0]) + 3 * unsigned((unsigned char)text[length - 1]) + unsigned(length)) & 15;
+}
+
+struct ReservedTable
+{
+    int slot[16];
+
+    constexpr ReservedTable() : slot()
+    {
+        for (int &entry : slot)
+        {
+            entry = -1;
+        }
+        for (int i = 0; i < int(sizeof(reservedWords) / sizeof(reservedWords[0])); i++)
+        {
+            slot[reservedHash(reservedWords[i].text, stringLength(reservedWords[i].text))] = i;
+        }
+    }
+
+    constexpr int count() const
+    {
+        int used = 0;
+        for (int entry : slot)
+        {
+            used += entry >= 0;
+        }
+        return used;
+    }
+};
+
+constexpr ReservedTable reservedTable;
+static_assert(reservedTable.count() == int(sizeof(reservedWords) / sizeof(reservedWords[0])),
+              "reserved word hash has a collision");
+
+// Returns the entry of a reserved word, or null for any other name.
+const ReservedWord *reservedWord(string_view text)
+{
+    if (text.size() < 2 || text.size() > 6)
+    {
+        return nullptr;
+    }
+    int index = reservedTable.slot[reservedHash(text.data(), text.size())];
+    if (index >= 0 && text == reservedWords[index].text)
+    {
+        return &reservedWords[index];
+    }
+    return nullptr;
+}
+
+// Interned names live in a deque so the views used as map keys stay valid.
+thread_local deque<string> symbolNames;
+thread_local unordered_map<string_view, int> symbolIds;
+
+// Names seen by a thread lexing one piece of a parallel lex. The table is not
+// shared between threads, so each piece numbers its names locally in order of
+// first appearance and they are interned after the threads finish.
+struct PieceSymbols
+{
+    unordered_map<string_view, int> ids;
+    vector<string_view> names;
+};
+thread_local PieceSymbols *pieceSymbols = nullptr;
+
+// The index of the source most recently lexed on this thread, which locate reads.
+thread_local LineIndex sourceLines{{0}, {}};
+
+thread_local LexErrors errors;
+}
+
+LexErrors &lexErrors()
+{
+    return errors;
+}
+
+LineIndex &sourceLineIndex()
+{
+    return sourceLines;
+}
+
+SourceLocation locate(uint32_t offset)
+{
+    const vector<uint32_t> &starts = sourceLines.lineStarts;
+    auto line = upper_bound(starts.begin(), starts.end(), offset) - 1;
+    auto skippedFrom = lower_bound(sourceLines.skipped.begin(), sourceLines.skipped.end(), *line);
+    auto skippedTo = lower_bound(skippedFrom, sourceLines.skipped.end(), offset);
+    return {sourceLines.firstLine + int(line - starts.begin()) + 1,
+            int(offset - *line - (skippedTo - skippedFrom)) + 1};
+}
+
+int internSymbol(string_view name)
+{
+    auto iter = symbolIds.find(name);
+    if (iter != symbolIds.end())
+    {
+        return iter->second;
+    }
+    symbolNames.emplace_back(name);
+    int symbol = int(symbolNames.size()) - 1;
+    symbolIds.emplace(symbolNames.back(), symbol);
+    return symbol;
+}
+
+const string &symbolName(int symbol)
+{
+    return symbolNames[symbol];
+}
+
+int symbolCount()
+{
+    return int(symbolNames.size());
+}
+
 void finishToken(Token &currToken, vector<Token> &tokens) {
-    if (currToken.length == 0) {
+    if (currToken.text.empty()) {
         return;
     }
     if (currToken.type == IDENTIFIER)
     {
-        if (currToken.text == "if" || currToken.text == "print" || currToken.text == "while" 
-                || currToken.text == "else" || currToken.text == "return" || currToken.text == "def")
+        if (const ReservedWord *reserved = reservedWord(currToken.text))
+        {
+            currToken.type = reserved->type;
+            currToken.kind = reserved->kind;
+        }
+        else if (pieceSymbols != nullptr)
         {
-            currToken.type = KEYWORD;
+            auto inserted = pieceSymbols->ids.emplace(currToken.text, int(pieceSymbols->names.size()));
+            if (inserted.second)
+            {
+                pieceSymbols->names.push_back(currToken.text);
+            }
+            currToken.symbol = inserted.first->second;
         }
-        if (currToken.text == "true" || currToken.text == "false")
+        else
         {
-            currToken.type = BOOLEAN;
+            currToken.symbol = internSymbol(currToken.text);
         }
-        if (currToken.text == "null")
+    }
+    else if (currToken.type == FLOAT)
+    {
+        const char *end = currToken.text.data() + currToken.text.size();
+        if (from_chars(currToken.text.data(), end, currToken.number).ec != errc())
         {
-            currToken.type = NULLVAL;
+            currToken.number = numeric_limits<double>::quiet_NaN();
         }
     }
+    else if (currToken.type != END && currToken.type != WHITESPACE)
+    {
+        currToken.kind = tokenKind(currToken.type, currToken.text);
+    }
     if (currToken.type != WHITESPACE)
     {
         tokens.push_back(currToken);
     }
-    currToken.columnNumber += currToken.length;
-    currToken.length = 0;
     currToken.type = WHITESPACE;
-    currToken.text = "";
+    currToken.kind = TokenKind::NONE;
+    currToken.text = string_view();
+    currToken.symbol = -1;
+    currToken.number = 0;
 }
 
-// Converts an input string into a list of tokens representing its content
-vector<Token> readTokens(string &input)
+namespace
 {
-    vector<Token> tokens;
-    Token currToken;
-    currToken.lineNumber = 1;
-    currToken.columnNumber = 1;
+// Character classes used to dispatch on the current character.
+enum CharClass : unsigned char
+{
+    CC_INVALID, // not allowed in a program
+    CC_NEWLINE, // \n
+    CC_BLANK, // space and tab, which end a token and advance the column
+    CC_SKIP, // \r, \v and \f, which are ignored without moving the column
+    CC_DIGIT,
+    CC_LETTER, // letters and underscore
+    CC_DOT,
+    CC_SINGLE, // delimiters, operators and logical operators
+    CC_COMPARE, // !, < and >, which may be followed by =
+    CC_EQUALS
+};
 
-    for (int i = 0; i < int(input.size()); i++)
+// 256-entry lookup tables indexed by the raw byte.
+struct CharTables
+{
+    CharClass charClass[256];
+    TokenType singleType[256];
+    TokenKind singleKind[256]; // of each one-character punctuator or operator
+
+    constexpr CharTables() : charClass(), singleType(), singleKind()
     {
-        char c = input[i];
+        charClass[int('\n')] = CC_NEWLINE;
+        charClass[int(' ')] = CC_BLANK;
+        charClass[int('\t')] = CC_BLANK;
+        charClass[int('\r')] = CC_SKIP;
+        charClass[int('\v')] = CC_SKIP;
+        charClass[int('\f')] = CC_SKIP;
+        for (int c = '0'; c <= '9'; c++)
+        {
+            charClass[c] = CC_DIGIT;
+        }
+        for (int c = 'a'; c <= 'z'; c++)
+        {
+            charClass[c] = CC_LETTER;
+            charClass[c - 'a' + 'A'] = CC_LETTER;
+        }
+        charClass[int('_')] = CC_LETTER;
+        charClass[int('.')] = CC_DOT;
+        charClass[int('!')] = CC_COMPARE;
+        charClass[int('<')] = CC_COMPARE;
+        charClass[int('>')] = CC_COMPARE;
+        charClass[int('=')] = CC_EQUALS;
 
-        // handle delimiters
-        switch (c)
+        const char singles[] = "(){}[];,+-*/%&|^";
+        const TokenType types[] = {LEFT_PAREN, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE, LEFT_BRACKET, RIGHT_BRACKET,
+                                   SEMICOLON, COMMA, OPERATOR, OPERATOR, OPERATOR, OPERATOR, OPERATOR,
+                                   LOGICAL, LOGICAL, LOGICAL};
+        const TokenKind kinds[] = {TokenKind::LEFT_PAREN, TokenKind::RIGHT_PAREN, TokenKind::LEFT_BRACE,
+                                   TokenKind::RIGHT_BRACE, TokenKind::LEFT_BRACKET, TokenKind::RIGHT_BRACKET,
+                                   TokenKind::SEMICOLON, TokenKind::COMMA, TokenKind::PLUS, TokenKind::MINUS,
+                                   TokenKind::STAR, TokenKind::SLASH, TokenKind::PERCENT, TokenKind::AND,
+                                   TokenKind::OR, TokenKind::XOR};
+        for (int i = 0; singles[i] != '\0'; i++)
         {
-        case '\n':
-            finishToken(currToken, tokens);
-            currToken.lineNumber++;
-            currToken.columnNumber = 1;
-            break;
-        case ' ':
-        case '\t':
+            charClass[int(singles[i])] = CC_SINGLE;
+            singleType[int(singles[i])] = types[i];
+            singleKind[int(singles[i])] = kinds[i];
+        }
+        singleKind[int('<')] = TokenKind::LT;
+        singleKind[int('>')] = TokenKind::GT;
+        singleKind[int('=')] = TokenKind::ASSIGN;
+    }
+};
+
+constexpr CharTables tables;
+
+inline CharClass classOf(char c)
+{
+    return tables.charClass[static_cast<unsigned char>(c)];
+}
+}
+
+TokenKind tokenKind(TokenType type, string_view text)
+{
+    switch (type)
+    {
+    case IDENTIFIER:
+    case KEYWORD:
+    case BOOLEAN:
+    case NULLVAL:
+        if (const ReservedWord *reserved = reservedWord(text))
+        {
+            return reserved->kind;
+        }
+        return TokenKind::NONE;
+    case FLOAT:
+    case WHITESPACE:
+    case END:
+    case OTHER:
+        return TokenKind::NONE;
+    default:
+        break;
+    }
+    if (text.size() == 1)
+    {
+        return tables.singleKind[static_cast<unsigned char>(text[0])];
+    }
+    if (text.size() == 2 && text[1] == '=')
+    {
+        switch (text[0])
+        {
+        case '=':
+            return TokenKind::EQ;
+        case '!':
+            return TokenKind::NE;
+        case '<':
+            return TokenKind::LE;
+        case '>':
+            return TokenKind::GE;
+        }
+    }
+    return TokenKind::NONE;
+}
+
+namespace
+{
+// Grows the current token by the characters in [from, to), where from is at
+// source offset offset. Normally the token is contiguous in the source and its
+// view is just extended, but one a skipped character splits is copied into
+// spliced.
+void appendToToken(Token &currToken, const char *from, const char *to, uint32_t offset, SplicedTexts &spliced)
+{
+    if (currToken.text.empty())
+    {
+        currToken.text = string_view(from, to - from);
+        currToken.offset = offset;
+    }
+    else if (currToken.text.data() + currToken.text.size() == from)
+    {
+        currToken.text = string_view(currToken.text.data(), currToken.text.size() + (to - from));
+    }
+    else
+    {
+        spliced.emplace_back(currToken.text);
+        spliced.back().append(from, to);
+        currToken.text = spliced.back();
+    }
+}
+
+#ifdef __SSE2__
+// Mask of the bytes in chunk that lie in [low, high]. Bytes above 0x7f are
+// negative as signed chars, so they never match an ASCII range.
+inline __m128i bytesInRange(__m128i chunk, char low, char high)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8(char(low - 1))),
+                         _mm_cmplt_epi8(chunk, _mm_set1_epi8(char(high + 1))));
+}
+#endif
+
+// Returns the end of the run of letters, digits and underscores starting at p.
+const char *scanIdentifier(const char *p, const char *end)
+{
+#ifdef __SSE2__
+    while (end - p >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        // setting bit 5 folds A-Z onto a-z without mapping anything else there
+        __m128i letters = bytesInRange(_mm_or_si128(chunk, _mm_set1_epi8(0x20)), 'a', 'z');
+        __m128i digits = bytesInRange(chunk, '0', '9');
+        __m128i underscores = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_'));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letters, digits), underscores));
+        if (mask != 0xFFFF)
+        {
+            return p + __builtin_ctz(~mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && (classOf(*p) == CC_LETTER || classOf(*p) == CC_DIGIT))
+    {
+        p++;
+    }
+    return p;
+}
+
+// Returns the end of the run of digits starting at p.
+const char *scanDigits(const char *p, const char *end)
+{
+    while (p < end && classOf(*p) == CC_DIGIT)
+    {
+        p++;
+    }
+    return p;
+}
+
+// Returns the end of the run of spaces and tabs starting at p.
+const char *scanBlanks(const char *p, const char *end)
+{
+#ifdef __SSE2__
+    while (end - p >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i blanks = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                                      _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t')));
+        int mask = _mm_movemask_epi8(blanks);
+        if (mask != 0xFFFF)
+        {
+            return p + __builtin_ctz(~mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && classOf(*p) == CC_BLANK)
+    {
+        p++;
+    }
+    return p;
+}
+
+// Lexes the characters in [p, end), which start at source offset offset, into
+// tokens, recording line starts and skipped characters in lines and keeping
+// spliced texts in spliced. Any unfinished token is carried in currToken.
+// Returns false on a lexical error, whose offset is left in currToken for the
+// caller to report.
+bool lexRange(Token &currToken, const char *p, const char *end, uint32_t offset, vector<Token> &tokens,
+              LineIndex &lines, SplicedTexts &spliced)
+{
+    const char *begin = p;
+    auto offsetOf = [begin, offset](const char *position) { return offset + uint32_t(position - begin); };
+    while (p < end)
+    {
+        const char *runEnd;
+        switch (classOf(*p))
+        {
+        case CC_NEWLINE:
             finishToken(currToken, tokens);
-            currToken.columnNumber++;
+            p++;
+            lines.lineStarts.push_back(offsetOf(p));
             break;
 
-        case '(':
-        case ')':
-        case '{':
-        case '}':
-        case '[':
-        case ']':
-        case ';':
-        case ',':
-            finishToken(currToken, tokens);
-            currToken.text += c;
-            currToken.length++;
-            if (c == '(')
-            {
-                currToken.type = LEFT_PAREN;
-            }
-            else if (c == ')')
-            {
-                currToken.type = RIGHT_PAREN;
-            }
-            else if (c == '{')
-            {
-                currToken.type = LEFT_BRACE;
-            }
-            else if (c == '}')
-            {
-                currToken.type = RIGHT_BRACE;
-            }
-            else if (c == '[')
-            {
-                currToken.type = LEFT_BRACKET;
-            }
-            else if (c == ']')
-            {
-                currToken.type = RIGHT_BRACKET;
-            }
-            else if (c == ';')
-            {
-                currToken.type = SEMICOLON;
-            }
-            else if (c == ',')
-            {
-                currToken.type = COMMA;
-            }
+        case CC_BLANK:
             finishToken(currToken, tokens);
+            p = scanBlanks(p + 1, end);
             break;
 
-        // handle operators
-        case '+':
-        case '-':
-        case '*':
-        case '/':
-        case '%':
-            finishToken(currToken, tokens);
-            currToken.text += c;
-            currToken.length++;
-            currToken.type = OPERATOR;
-            finishToken(currToken, tokens);
+        // other whitespace neither ends the current token nor takes a column
+        case CC_SKIP:
+            lines.skipped.push_back(offsetOf(p));
+            p++;
             break;
-        
-        // handle logical operators
-        case '&':
-        case '|':
-        case '^':
+
+        // handle delimiters, operators and logical operators
+        case CC_SINGLE:
             finishToken(currToken, tokens);
-            currToken.text += c;
-            currToken.length++;
-            currToken.type = LOGICAL;
+            currToken.type = tables.singleType[static_cast<unsigned char>(*p)];
+            appendToToken(currToken, p, p + 1, offsetOf(p), spliced);
             finishToken(currToken, tokens);
+            p++;
             break;
 
         // handle comparators
-        case '!':
-        case '>':
-        case '<':
+        case CC_COMPARE:
             finishToken(currToken, tokens);
             currToken.type = COMPARATOR;
-            currToken.text += c;
-            currToken.length++;
+            appendToToken(currToken, p, p + 1, offsetOf(p), spliced);
+            p++;
             break;
-        
+
         // either operator or comparator
-        case '=':
+        case CC_EQUALS:
             // handle == case
             if (currToken.text == "=") {
                 currToken.type = COMPARATOR;
             }
             // handle !=, >=, <=, == comparator cases
             if (currToken.type == COMPARATOR) {
-                currToken.text += c;
-                currToken.length++;
+                appendToToken(currToken, p, p + 1, offsetOf(p), spliced);
                 finishToken(currToken, tokens);
             }
             // default assingment operator case
             else {
                 finishToken(currToken, tokens);
                 currToken.type = OPERATOR;
-                currToken.text += c;
-                currToken.length++;
+                appendToToken(currToken, p, p + 1, offsetOf(p), spliced);
             }
+            p++;
             break;
 
-        // handle numbers
-        case '0':
-        case '1':
-        case '2':
-        case '3':
-        case '4':
-        case '5':
-        case '6':
-        case '7':
-        case '8':
-        case '9':
-            if (currToken.type != FLOAT && currToken.type != IDENTIFIER) {
-                finishToken(currToken, tokens);
-                currToken.type = FLOAT;
+        // handle numbers, which also continue an identifier
+        case CC_DIGIT:
+            if (currToken.type == IDENTIFIER)
+            {
+                runEnd = scanIdentifier(p + 1, end);
+            }
+            else
+            {
+                if (currToken.type != FLOAT)
+                {
+                    finishToken(currToken, tokens);
+                    currToken.type = FLOAT;
+                }
+                runEnd = scanDigits(p + 1, end);
             }
-            currToken.text += c;
-            currToken.length++;
+            appendToToken(currToken, p, runEnd, offsetOf(p), spliced);
+            p = runEnd;
             break;
 
-        case '.':
-            if (currToken.type != FLOAT || currToken.text.find(".") != string::npos)
+        case CC_DOT:
+            if (currToken.type != FLOAT || currToken.text.find('.') != string_view::npos)
             {
                 finishToken(currToken, tokens);
-                LexError(tokens, currToken.lineNumber, currToken.columnNumber);
-                vector<Token> empty;
-                return empty;
+                currToken.offset = offsetOf(p);
+                return false;
             }
-            else if (i == int(input.size()) - 1  || !(input[i+1] >= '0' && input[i+1] <= '9'))
+            // a trailing dot is reported just past itself
+            else if (p + 1 == end || classOf(p[1]) != CC_DIGIT)
             {
-                currToken.length++;
                 finishToken(currToken, tokens);
-                LexError(tokens, currToken.lineNumber, currToken.columnNumber);
-                vector<Token> empty;
-                return empty;
+                currToken.offset = offsetOf(p + 1);
+                return false;
             }
-            currToken.text += c;
-            currToken.length++;
+            appendToToken(currToken, p, p + 1, offsetOf(p), spliced);
+            p++;
             break;
 
         // handle identifiers
-        case '_':
-        case 'a':
-        case 'A':
-        case 'b':
-        case 'B':
-        case 'c':
-        case 'C':
-        case 'd':
-        case 'D':
-        case 'e':
-        case 'E':
-        case 'f':
-        case 'F':
-        case 'g':
-        case 'G':
-        case 'h':
-        case 'H':
-        case 'i':
-        case 'I':
-        case 'j':
-        case 'J':
-        case 'k':
-        case 'K':
-        case 'l':
-        case 'L':
-        case 'm':
-        case 'M':
-        case 'n':
-        case 'N':
-        case 'o':
-        case 'O':
-        case 'p':
-        case 'P':
-        case 'q':
-        case 'Q':
-        case 'r':
-        case 'R':
-        case 's':
-        case 'S':
-        case 't':
-        case 'T':
-        case 'u':
-        case 'U':
-        case 'v':
-        case 'V':
-        case 'w':
-        case 'W':
-        case 'x':
-        case 'X':
-        case 'y':
-        case 'Y':
-        case 'z':
-        case 'Z':
+        case CC_LETTER:
             if (currToken.type != IDENTIFIER)
             {
                 finishToken(currToken, tokens);
                 currToken.type = IDENTIFIER;
             }
-            currToken.text += c;
-            currToken.length++;
+            runEnd = scanIdentifier(p + 1, end);
+            appendToToken(currToken, p, runEnd, offsetOf(p), spliced);
+            p = runEnd;
             break;
 
         // handle unknown tokens (syntax error)
         default:
-            if (!isspace(c))
-            {
-                finishToken(currToken, tokens);
-                LexError(tokens, currToken.lineNumber, currToken.columnNumber);
-                vector<Token> empty;
-                return empty;
-            }
+            finishToken(currToken, tokens);
+            currToken.offset = offsetOf(p);
+            return false;
         }
     }
-    finishToken(currToken, tokens);
-    // post-processing
+    return true;
+}
+
+// One piece of a parallel lex: whole lines of the input, lexed on their own.
+struct LexPiece
+{
+    string_view text;
+    uint32_t offset{0}; // of the piece in the input
+    vector<Token> tokens;
+    PieceSymbols symbols;
+    LineIndex lines;
+    SplicedTexts spliced;
+    Token endToken; // holds the offset of a lexical error
+    bool error{false};
+    size_t firstToken{0}; // tokens before the piece
+};
+
+void lexPiece(LexPiece &piece)
+{
+    pieceSymbols = &piece.symbols;
+    piece.tokens.reserve(piece.text.size() / 4 + 16);
+    piece.error = !lexRange(piece.endToken, piece.text.data(), piece.text.data() + piece.text.size(), piece.offset,
+                            piece.tokens, piece.lines, piece.spliced);
+    if (!piece.error)
+    {
+        // only the last piece can end in the middle of a token
+        finishToken(piece.endToken, piece.tokens);
+    }
+    pieceSymbols = nullptr;
+}
+
+// Moves a lexed piece into its place in the combined token list, replacing its
+// local symbol ids with interned ones.
+void placePiece(const LexPiece &piece, const vector<int> &symbols, vector<Token> &tokens)
+{
+    Token *out = tokens.data() + piece.firstToken;
+    for (const Token &token : piece.tokens)
+    {
+        *out = token;
+        if (token.symbol >= 0)
+        {
+            out->symbol = symbols[token.symbol];
+        }
+        out++;
+    }
+}
+
+// Runs work(i) for every i below count, spread over count threads.
+template <typename Work>
+void runOnThreads(size_t count, Work work)
+{
+    vector<thread> threads;
+    for (size_t i = 1; i < count; i++)
+    {
+        threads.emplace_back(work, i);
+    }
+    work(size_t(0));
+    for (thread &worker : threads)
+    {
+        worker.join();
+    }
+}
+
+// Applies the end of input rules: a program whose last or second to last
+// token is named error yields no tokens, anything else gets an END token at
+// endOffset.
+bool finishTokens(vector<Token> &tokens, Token &currToken, uint32_t endOffset)
+{
     if ((!tokens.empty() && tokens.back().text == "error" ) || (tokens.size() > 2 && tokens[tokens.size() - 2].text == "error")) 
     {
-        vector<Token> empty;
-        return empty;
+        errors.found = true;
+        errors.offset = tokens.back().text == "error" ? tokens.back().offset : tokens[tokens.size() - 2].offset;
+        return false;
     }
     else if (tokens.empty() || tokens.back().type != END)
     {   
         currToken.type = END;
         currToken.text = "END";
-        currToken.length++;
+        currToken.offset = endOffset;
         finishToken(currToken, tokens);
     }
-    
+    return true;
+}
+}
+
+vector<Token> readTokens(string &input, SplicedTexts &spliced)
+{
+    return readTokens(string_view(input), spliced);
+}
+
+// Converts an input string into a list of tokens representing its content
+vector<Token> readTokens(string_view input, SplicedTexts &spliced)
+{
+    if (input.size() >= parallelLexThreshold)
+    {
+        unsigned threadCount = thread::hardware_concurrency();
+        if (threadCount > 1)
+        {
+            return readTokensParallel(input, threadCount, spliced);
+        }
+    }
+
+    vector<Token> tokens;
+    // programs average a little over one token per four bytes, so this avoids
+    // most of the regrowth copies on large inputs
+    tokens.reserve(input.size() / 4 + 16);
+    Token currToken;
+    sourceLines = LineIndex{{0}, {}};
+
+    if (!lexRange(currToken, input.data(), input.data() + input.size(), 0, tokens, sourceLines, spliced))
+    {
+        LexError(tokens, currToken.offset);
+        vector<Token> empty;
+        return empty;
+    }
+    finishToken(currToken, tokens);
+    // post-processing
+    if (!finishTokens(tokens, currToken, uint32_t(input.size())))
+    {
+        vector<Token> empty;
+        return empty;
+    }
+    return tokens;
+}
+
+// Tokens never span lines, so the input is cut into pieces just after a
+// newline and each piece is lexed on its own thread.
+vector<Token> readTokensParallel(string_view input, unsigned threadCount, SplicedTexts &spliced)
+{
+    vector<LexPiece> pieces;
+    size_t start = 0;
+    for (unsigned i = 1; i <= threadCount && start < input.size(); i++)
+    {
+        size_t cut = input.size();
+        if (i < threadCount)
+        {
+            cut = input.find('\n', max(start, input.size() / threadCount * i));
+            cut = cut == string_view::npos ? input.size() : cut + 1;
+        }
+        pieces.emplace_back();
+        pieces.back().text = input.substr(start, cut - start);
+        pieces.back().offset = uint32_t(start);
+        start = cut;
+    }
+    if (pieces.empty())
+    {
+        pieces.emplace_back();
+    }
+    runOnThreads(pieces.size(), [&pieces](size_t i) { lexPiece(pieces[i]); });
+
+    sourceLines = LineIndex{{0}, {}};
+    for (LexPiece &piece : pieces)
+    {
+        spliced.splice(spliced.end(), piece.spliced);
+        sourceLines.lineStarts.insert(sourceLines.lineStarts.end(), piece.lines.lineStarts.begin(),
+                                      piece.lines.lineStarts.end());
+        sourceLines.skipped.insert(sourceLines.skipped.end(), piece.lines.skipped.begin(), piece.lines.skipped.end());
+    }
+
+    // interning the pieces' names in order numbers them as a serial lex would,
+    // which also interns the names it meets before stopping at an error
+    vector<vector<int>> symbols(pieces.size());
+    for (size_t i = 0; i < pieces.size(); i++)
+    {
+        for (string_view name : pieces[i].symbols.names)
+        {
+            symbols[i].push_back(internSymbol(name));
+        }
+        if (pieces[i].error)
+        {
+            break;
+        }
+    }
+
+    // the earliest piece with an error holds the error a serial lex stops at
+    vector<Token> tokens;
+    size_t tokenCount = 0;
+    for (LexPiece &piece : pieces)
+    {
+        if (piece.error)
+        {
+            LexError(tokens, piece.endToken.offset);
+            vector<Token> empty;
+            return empty;
+        }
+        piece.firstToken = tokenCount;
+        tokenCount += piece.tokens.size();
+    }
+
+    tokens.reserve(tokenCount + 1);
+    tokens.resize(tokenCount);
+    runOnThreads(pieces.size(), [&](size_t i) { placePiece(pieces[i], symbols[i], tokens); });
+
+    Token currToken = pieces.back().endToken;
+    if (!finishTokens(tokens, currToken, uint32_t(input.size())))
+    {
+        vector<Token> empty;
+        return empty;
+    }
     return tokens;
 }
 
 // Checks for lexical errors in the given list of tokens
-void LexError(vector<Token> &tokens, int lineNumber, int columnNumber)
+void LexError(vector<Token> &tokens, uint32_t offset)
+{
+    errors.found = true;
+    errors.offset = offset;
+    if (!errors.quiet)
+    {
+        SourceLocation location = locate(offset);
+        cout << "Syntax error on line " << location.line << " column "
+                << location.column << "." << endl;
+    }
+    tokens.push_back({OTHER, TokenKind::NONE, "error", offset});
+}
+
+TokenStream::TokenStream(istream &in, size_t chunkSize) : in(in), chunkSize(chunkSize)
+{
+    sourceLines = LineIndex{{0}, {}};
+}
+
+bool TokenStream::next(Token &token)
+{
+    while (nextPending == pending.size())
+    {
+        if (finished || !refill())
+        {
+            return false;
+        }
+    }
+    token = pending[nextPending++];
+    return true;
+}
+
+// Reads until the buffer holds at least one complete line (or the rest of the
+// input) and lexes those lines into pending.
+bool TokenStream::refill()
+{
+    // everything left after the lexed lines is part of one unfinished line
+    buffer.erase(0, lexedLength);
+    bufferOffset += uint32_t(lexedLength);
+    pending.clear();
+    spliced.clear();
+    nextPending = 0;
+
+    // the tokens lexed so far have all been handed out, so only the start of
+    // the line the buffer begins on is still needed
+    vector<uint32_t> &starts = sourceLines.lineStarts;
+    size_t done = size_t(upper_bound(starts.begin(), starts.end(), bufferOffset) - starts.begin()) - 1;
+    starts.erase(starts.begin(), starts.begin() + ptrdiff_t(done));
+    sourceLines.firstLine += int(done);
+    sourceLines.skipped.erase(sourceLines.skipped.begin(),
+                              lower_bound(sourceLines.skipped.begin(), sourceLines.skipped.end(), starts[0]));
+
+    size_t newline = string::npos;
+    bool atEnd = false;
+    while (newline == string::npos && !atEnd)
+    {
+        size_t oldSize = buffer.size();
+        buffer.resize(oldSize + chunkSize);
+        in.read(&buffer[oldSize], streamsize(chunkSize));
+        buffer.resize(oldSize + size_t(in.gcount()));
+        atEnd = size_t(in.gcount()) < chunkSize;
+        newline = buffer.rfind('\n');
+    }
+    lexedLength = atEnd ? buffer.size() : newline + 1;
+
+    if (!lexRange(currToken, buffer.data(), buffer.data() + lexedLength, bufferOffset, pending, sourceLines, spliced))
+    {
+        LexError(pending, currToken.offset);
+        pending.clear();
+        error = true;
+        finished = true;
+        return false;
+    }
+    if (atEnd)
+    {
+        finishToken(currToken, pending);
+    }
+    for (const Token &token : pending)
+    {
+        secondLastIsError = lastIsError;
+        lastIsError = token.text == "error";
+        tokenCount++;
+    }
+    if (atEnd)
+    {
+        finished = true;
+        if (lastIsError || (tokenCount > 2 && secondLastIsError))
+        {
+            // readTokens drops the whole program here without a message
+            pending.clear();
+            error = true;
+            return false;
+        }
+        currToken.type = END;
+        currToken.text = "END";
+        currToken.offset = bufferOffset + uint32_t(lexedLength);
+        finishToken(currToken, pending);
+    }
+    return true;
+}
+
+SourceText::SourceText(const char *path)
+{
+    if (path == nullptr)
+    {
+        if (!readAll(STDIN_FILENO))
+        {
+            cout << "Could not read standard input." << endl;
+            exit(1);
+        }
+        return;
+    }
+
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0)
+    {
+        cout << "Could not read file " << path << "." << endl;
+        exit(1);
+    }
+    // pipes, devices and files like those in /proc report no size of their
+    // own and cannot be mapped, so only a regular file with content is
+    if (!S_ISREG(info.st_mode) || info.st_size == 0)
+    {
+        bool read = readAll(fd);
+        close(fd);
+        if (!read)
+        {
+            cout << "Could not read file " << path << "." << endl;
+            exit(1);
+        }
+        return;
+    }
+    size = size_t(info.st_size);
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        cout << "Could not read file " << path << "." << endl;
+        exit(1);
+    }
+    // the lexer makes a single forward pass over the file
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    data = static_cast<const char *>(mapping);
+    mapped = true;
+    close(fd);
+}
+
+bool SourceText::readAll(int fd)
+{
+    // pull the input in large blocks instead of line by line
+    size_t length = 0;
+    buffer.resize(64 * 1024);
+    while (true)
+    {
+        ssize_t count = read(fd, &buffer[length], buffer.size() - length);
+        if (count == 0)
+        {
+            break;
+        }
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        length += size_t(count);
+        if (length == buffer.size())
+        {
+            buffer.resize(buffer.size() * 2);
+        }
+    }
+    buffer.resize(length);
+    data = buffer.data();
+    size = length;
+    return true;
+}
+
+SourceText::~SourceText()
+{
+    if (mapped)
+    {
+        munmap(const_cast<char *>(data), size);
+    }
+}
+
+void printToken(ostream &out, const Token &token)
 {
-    cout << "Syntax error on line " << lineNumber << " column "
-            << columnNumber << "." << endl;
-    tokens.push_back({OTHER, "error", 0, lineNumber, columnNumber});
+    SourceLocation location = locate(token.offset);
+    out << setw(4) << location.line << setw(5) << location.column << "  " << token.text << '\n';
 }
 
 void printTokens(vector<Token> &tokens)
 {
     for (const Token &token : tokens)
     {
-        cout << setw(4) << token.lineNumber << setw(5) << token.columnNumber << "  " << token.text << endl;
+        SourceLocation location = locate(token.offset);
+        cout << setw(4) << location.line << setw(5) << location.column << "  " << token.text << endl;
     }
 }
\ No newline at end of file
@@ -13,7 +13,7 @@ public:
     AST(const vector<Token> &tokens, int &index);
     ~AST();
 
-    double evaluateAST(std::unordered_map<std::string, double>& variables);
+    double evaluateAST(std::unordered_map<int, double>& variables);
     void printInfix() const;
     //for debugging purposes (to see the created tree):
     //void printAST(Node node, int depth);
@@ -21,7 +21,7 @@ public:
 private:
     Node root;
 
-    double evaluate(Node root, std::unordered_map<std::string, double>& variables) const;
+    double evaluate(Node root, std::unordered_map<int, double>& variables) const;
     Node makeTree(const vector<Token> &tokens, int &index);
     void printInfix(const Node node) const;
 };
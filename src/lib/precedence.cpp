@@ -0,0 +1,35 @@
+#include "precedence.hpp"
+
+using namespace std;
+
+Precedence binaryPrecedence(const Token &token)
+{
+    switch (token.kind)
+    {
+    case TokenKind::ASSIGN:
+        return ASSIGNMENT;
+    case TokenKind::OR:
+        return LOGIC_OR;
+    case TokenKind::XOR:
+        return LOGIC_XOR;
+    case TokenKind::AND:
+        return LOGIC_AND;
+    case TokenKind::EQ:
+    case TokenKind::NE:
+        return EQUALITY;
+    case TokenKind::LT:
+    case TokenKind::LE:
+    case TokenKind::GT:
+    case TokenKind::GE:
+        return COMPARISON;
+    case TokenKind::PLUS:
+    case TokenKind::MINUS:
+        return ADDITIVE;
+    case TokenKind::STAR:
+    case TokenKind::SLASH:
+    case TokenKind::PERCENT:
+        return MULTIPLICATIVE;
+    default:
+        return NO_PRECEDENCE;
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "token.hpp"
+
+// How tightly each binary operator binds, loosest first. The scrypt, format
+// and calc parsers all climb this one table instead of keeping a function per
+// level. Every level groups to the left except assignment, which nests to the
+// right.
+enum Precedence
+{
+    NO_PRECEDENCE, // not a binary operator
+    ASSIGNMENT, // =
+    LOGIC_OR, // |
+    LOGIC_XOR, // ^
+    LOGIC_AND, // &
+    EQUALITY, // ==, !=
+    COMPARISON, // <, <=, >, >=
+    ADDITIVE, // +, -
+    MULTIPLICATIVE // *, /, %
+};
+
+// The level of the binary operator token is, or NO_PRECEDENCE.
+Precedence binaryPrecedence(const Token &token);
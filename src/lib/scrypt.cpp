@@ -0,0 +1,841 @@
+#include "scrypt.hpp"
+#include <unordered_map>
+#include <iostream>
+#include <limits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+// Labels as values let each instruction jump straight to the next one's
+// handler instead of going back through a switch.
+#if defined(__GNUC__)
+#define SCRYPT_COMPUTED_GOTO
+#endif
+
+namespace
+{
+// what the evaluator gave for an operand the parser left out, and what
+// returnValue holds while no return is pending
+const Value noValue{numeric_limits<double>::quiet_NaN()};
+
+[[noreturn]] void runtimeError(const string &message)
+{
+    cout << "Runtime error: " << message << endl;
+    exit(3);
+}
+
+// What a slot holds until a value is assigned to it: a function value that
+// no definition can make.
+const Value unset{shared_ptr<Function>()};
+
+// What a slot of a call holds until the name is first read there: another
+// function value no definition makes, which owns nothing.
+Function unresolvedTarget;
+const Value unresolved{shared_ptr<Function>(shared_ptr<Function>(), &unresolvedTarget)};
+
+bool isUnresolved(const Value &value)
+{
+    return value.index() == 4 && get<shared_ptr<Function>>(value).get() == &unresolvedTarget;
+}
+
+bool isSet(const Value &value)
+{
+    return value.index() != 4 || (get<shared_ptr<Function>>(value) != nullptr && !isUnresolved(value));
+}
+
+bool isFunction(const Value &value)
+{
+    return value.index() == 4 && isSet(value);
+}
+
+void checkIndex(const Value &index)
+{
+    double intPart;
+    if (index.index() != 0 || modf(get<double>(index), &intPart) != 0)
+    {
+        runtimeError("index is not an integer.");
+    }
+}
+
+// The elements of array, which index, an integer, has to be in bounds of.
+vector<Value> &checkElement(const Value &array, const Value &index)
+{
+    if (array.index() != 3)
+    {
+        runtimeError("not an array.");
+    }
+    vector<Value> &elements = *get<shared_ptr<vector<Value>>>(array);
+    if (int(get<double>(index)) >= int(elements.size()))
+    {
+        runtimeError("index out of bounds.");
+    }
+    return elements;
+}
+
+double arithmetic(TokenKind op, double left, double right)
+{
+    switch (op)
+    {
+    case TokenKind::PLUS:
+        return left + right;
+    case TokenKind::MINUS:
+        return left - right;
+    case TokenKind::STAR:
+        return left * right;
+    case TokenKind::SLASH:
+        if (right == 0)
+        {
+            runtimeError("division by zero.");
+        }
+        return left / right;
+    default:
+        return fmod(left, right);
+    }
+}
+
+bool compare(TokenKind op, const Value &left, const Value &right)
+{
+    switch (op)
+    {
+    case TokenKind::EQ:
+        return !(left != right);
+    case TokenKind::NE:
+        return left != right;
+    case TokenKind::LT:
+        return left < right;
+    case TokenKind::LE:
+        return left <= right;
+    case TokenKind::GT:
+        return left > right;
+    default:
+        return left >= right;
+    }
+}
+
+bool logic(TokenKind op, bool left, const Value &right)
+{
+    switch (op)
+    {
+    case TokenKind::AND:
+        return left && get<bool>(right);
+    case TokenKind::OR:
+        return left || get<bool>(right);
+    default:
+        return left != get<bool>(right);
+    }
+}
+
+// The checks an operator makes on its operands, which can throw as get does
+// on a value of the wrong type.
+void checkOperands(TokenKind op, const Value &left, const Value &right)
+{
+    switch (op)
+    {
+    case TokenKind::PLUS:
+    case TokenKind::MINUS:
+    case TokenKind::STAR:
+    case TokenKind::SLASH:
+    case TokenKind::PERCENT:
+        if (holds_alternative<bool>(right))
+        {
+            runtimeError("invalid operand type.");
+        }
+        (void)get<double>(left);
+        break;
+    case TokenKind::AND:
+    case TokenKind::OR:
+    case TokenKind::XOR:
+        if (holds_alternative<double>(right) || holds_alternative<double>(left))
+        {
+            runtimeError("invalid operand type.");
+        }
+        (void)get<bool>(left);
+        break;
+    case TokenKind::EQ:
+    case TokenKind::NE:
+        // any two values can be compared for equality
+        break;
+    default:
+        if (holds_alternative<double>(right) != holds_alternative<double>(left))
+        {
+            runtimeError("invalid operand type.");
+        }
+        break;
+    }
+}
+
+// The result of an operator on its checked operands.
+Value apply(TokenKind op, const Value &left, const Value &right)
+{
+    switch (op)
+    {
+    case TokenKind::PLUS:
+    case TokenKind::MINUS:
+    case TokenKind::STAR:
+    case TokenKind::SLASH:
+    case TokenKind::PERCENT:
+        return Value{arithmetic(op, get<double>(left), get<double>(right))};
+    case TokenKind::AND:
+    case TokenKind::OR:
+    case TokenKind::XOR:
+        return Value{logic(op, get<bool>(left), right)};
+    default:
+        return Value{compare(op, left, right)};
+    }
+}
+}
+
+const Chunk &Machine::functionCode(NodeIndex def)
+{
+    auto found = functions.find(def);
+    if (found == functions.end())
+    {
+        found = functions.emplace(def, compileFunction(def)).first;
+    }
+    return found->second;
+}
+
+Value &Machine::resolve(uint32_t slot)
+{
+    const Frame &frame = frames.back();
+    if (isUnresolved(stack[frame.slots + slot]))
+    {
+        // which fills the slot in
+        view(frame.chunk->names[slot]);
+    }
+    return stack[frame.slots + slot];
+}
+
+const Value &Machine::load(const Instruction &instruction)
+{
+    const Value &value = resolve(instruction.a);
+    if (!isSet(value))
+    {
+        runtimeError("unknown identifier " + string(syntaxTree().token(instruction.b).text));
+    }
+    return value;
+}
+
+const Value &Machine::view(int symbol)
+{
+    // down the bindings of the name to the nearest that knows what it holds...
+    pending.clear();
+    uint32_t binding = bindingOf(symbol);
+    while (binding != noBinding && bound[binding].slot != noSlot && isUnresolved(slotFor(bound[binding])))
+    {
+        pending.push_back(binding);
+        binding = bound[binding].below;
+    }
+    const Value *value = &unset;
+    size_t level = 0;
+    if (binding != noBinding)
+    {
+        level = bound[binding].depth;
+        value = bound[binding].slot == noSlot ? &bound[binding].value : &slotFor(bound[binding]);
+    }
+    // ...then back up, each call taking a function its caller sees by the
+    // name and anything else from what its function was defined with, and
+    // keeping that in its slot, or in a binding of its own if it has none
+    uint32_t below = binding;
+    while (++level < frames.size())
+    {
+        const Frame &frame = frames[level];
+        if (!isFunction(*value))
+        {
+            value = &captured(*frame.function, symbol);
+        }
+        if (!pending.empty() && bound[pending.back()].depth == level)
+        {
+            below = pending.back();
+            pending.pop_back();
+            Value &slot = slotFor(bound[below]);
+            slot = *value;
+            value = &slot;
+        }
+        else
+        {
+            below = addBinding(Binding{uint32_t(level), noSlot, frame.call, below, *value});
+            (pending.empty() ? bindings[symbol] : bound[pending.back()].below) = below;
+            value = &bound[below].value;
+        }
+    }
+    return *value;
+}
+
+uint32_t Machine::bindingOf(int symbol)
+{
+    // a frame's bindings are left behind when it ends, and are all above
+    // those of the frames below it
+    uint32_t &top = bindings[symbol];
+    while (top != noBinding &&
+           (bound[top].depth >= frames.size() || frames[bound[top].depth].call != bound[top].call))
+    {
+        uint32_t ended = top;
+        top = bound[ended].below;
+        bound[ended].below = unbound;
+        bound[ended].value = unset;
+        unbound = ended;
+    }
+    return top;
+}
+
+uint32_t Machine::addBinding(const Binding &binding)
+{
+    if (unbound == noBinding)
+    {
+        bound.push_back(binding);
+        return uint32_t(bound.size() - 1);
+    }
+    uint32_t index = unbound;
+    unbound = bound[index].below;
+    bound[index] = binding;
+    return index;
+}
+
+Value &Machine::slotFor(const Binding &binding)
+{
+    return stack[frames[binding.depth].slots + binding.slot];
+}
+
+const Value &Machine::captured(const Function &function, int symbol)
+{
+    if (function.scope != nullptr)
+    {
+        return lookup(*function.scope, symbol);
+    }
+    return global(function.globals, symbol);
+}
+
+const Value &Machine::lookup(Scope &scope, int symbol)
+{
+    // down the scopes to the nearest that knows what the name held...
+    size_t mark = walked.size();
+    const Value *value = &unset;
+    for (Scope *level = &scope; level != nullptr; level = level->below.get())
+    {
+        uint32_t slot = slotOf(*level->chunk, symbol);
+        if (slot != noSlot && !isUnresolved(level->values[slot]))
+        {
+            value = &level->values[slot];
+            break;
+        }
+        auto seen = level->seen.find(symbol);
+        if (seen != level->seen.end())
+        {
+            value = &seen->second;
+            break;
+        }
+        walked.push_back(level);
+        if (level->below == nullptr)
+        {
+            value = &global(level->globals, symbol);
+        }
+    }
+    // ...then back up as view does, which can look up through other scopes
+    // on top of these
+    while (walked.size() > mark)
+    {
+        Scope &level = *walked.back();
+        walked.pop_back();
+        if (!isFunction(*value))
+        {
+            value = &captured(*level.function, symbol);
+        }
+        uint32_t slot = slotOf(*level.chunk, symbol);
+        Value &kept = slot != noSlot ? level.values[slot] : level.seen[symbol];
+        kept = *value;
+        value = &kept;
+    }
+    return *value;
+}
+
+const Value &Machine::global(const vector<shared_ptr<const SlotBlock>> &globals, int symbol) const
+{
+    uint32_t slot = globalSlots[symbol];
+    if (slot == noSlot)
+    {
+        return unset;
+    }
+    return (*globals[slot / slotBlockSize])[slot % slotBlockSize];
+}
+
+const shared_ptr<Scope> &Machine::scopeOf(size_t depth)
+{
+    // from the lowest frame whose copy is not up to date
+    size_t level = depth;
+    while (level > 1 && frames[level].scope == nullptr && frames[level - 1].scope == nullptr)
+    {
+        level--;
+    }
+    for (; level <= depth; level++)
+    {
+        Frame &frame = frames[level];
+        if (frame.scope != nullptr)
+        {
+            continue;
+        }
+        auto scope = make_shared<Scope>();
+        scope->chunk = frame.chunk;
+        scope->values.assign(stack.begin() + frame.slots, stack.begin() + frame.slots + frame.chunk->names.size());
+        scope->function = get<shared_ptr<Function>>(stack[frame.base]);
+        if (level > 1)
+        {
+            scope->below = frames[level - 1].scope;
+        }
+        else
+        {
+            scope->globals = captureGlobals();
+        }
+        frame.scope = move(scope);
+    }
+    return frames[depth].scope;
+}
+
+const vector<shared_ptr<const SlotBlock>> &Machine::captureGlobals()
+{
+    // the top-level slots are at the bottom of the stack
+    size_t count = frames[0].chunk->names.size();
+    for (size_t block = 0; block < globalBlocks.size(); block++)
+    {
+        if (changedBlocks[block])
+        {
+            auto copy = make_shared<SlotBlock>();
+            size_t first = block * slotBlockSize;
+            size_t last = min(first + slotBlockSize, count);
+            std::copy(stack.begin() + first, stack.begin() + last, copy->begin());
+            globalBlocks[block] = move(copy);
+            changedBlocks[block] = 0;
+        }
+    }
+    return globalBlocks;
+}
+
+void Machine::run(const Chunk &program)
+{
+    const FlatTree &tree = syntaxTree();
+    stack.reserve(4096);
+    frames.reserve(256);
+    bound.reserve(4096);
+    stack.assign(program.names.size(), unset);
+    frames.push_back(Frame{&program, nullptr, 0, nullptr, 0, 0, nullptr});
+    globalSlots.assign(size_t(symbolCount()), noSlot);
+    bindings.assign(size_t(symbolCount()), noBinding);
+    for (size_t slot = 0; slot < program.names.size(); slot++)
+    {
+        globalSlots[program.names[slot]] = uint32_t(slot);
+        bindings[program.names[slot]] = addBinding(Binding{0, uint32_t(slot), 0, noBinding, unset});
+    }
+    size_t blocks = (program.names.size() + slotBlockSize - 1) / slotBlockSize;
+    globalBlocks.assign(blocks, nullptr);
+    changedBlocks.assign(blocks, 1);
+    // position of the current frame's first slot, as the stack can move
+    size_t slots = 0;
+    const Instruction *code = program.code.data();
+    const Instruction *pc = code;
+    const Instruction *instruction;
+    Value result;
+
+#ifdef SCRYPT_COMPUTED_GOTO
+    // in the order of OpCode
+    static const void *const handlers[] = {
+        &&op_PUSH_NUMBER, &&op_PUSH_LITERAL, &&op_PUSH_TRUE, &&op_PUSH_FALSE, &&op_PUSH_NULL, &&op_PUSH_NAN,
+        &&op_POP, &&op_LOAD, &&op_STORE, &&op_STORE_POP, &&op_STORE_GLOBAL, &&op_STORE_GLOBAL_POP, &&op_MAKE_ARRAY, &&op_CHECK_INDEX, &&op_GET_ELEMENT,
+        &&op_LOAD_ELEMENT, &&op_SET_ELEMENT, &&op_ARRAY_LENGTH, &&op_ARRAY_PUSH, &&op_ARRAY_POP,
+        &&op_CHECK_NOT_BOOL, &&op_KEEP_IF, &&op_ADD, &&op_SUBTRACT, &&op_MULTIPLY, &&op_DIVIDE, &&op_MODULO,
+        &&op_EQUAL, &&op_NOT_EQUAL, &&op_LESS, &&op_LESS_EQUAL, &&op_GREATER, &&op_GREATER_EQUAL, &&op_AND,
+        &&op_OR, &&op_XOR, &&op_JUMP, &&op_BRANCH_FALSE, &&op_HALT, &&op_PRINT, &&op_DEFINE, &&op_BEGIN_STATEMENT, &&op_CHECK_RETURN, &&op_SET_RETURN,
+        &&op_RETURN_IF_SET, &&op_END_FUNCTION, &&op_PREPARE_CALL, &&op_CALL, &&op_INVALID_ASSIGNEE,
+        &&op_BAD_ARGUMENT_COUNT, &&op_UNEXPECTED_NODE};
+    static_assert(sizeof(handlers) / sizeof(handlers[0]) == size_t(OpCode::UNEXPECTED_NODE) + 1,
+                  "a handler for every opcode");
+    // a computed goto leaves a block without destroying its locals, so a
+    // handler that needs any keeps them in a block and dispatches after it
+#define TARGET(name) op_##name:
+#define DISPATCH()                                      \
+    do                                                  \
+    {                                                   \
+        instruction = pc++;                             \
+        goto *handlers[size_t(instruction->op)];        \
+    } while (0)
+    DISPATCH();
+#else
+#define TARGET(name) case OpCode::name:
+#define DISPATCH() goto dispatch
+dispatch:
+    instruction = pc++;
+    switch (instruction->op)
+#endif
+    {
+    TARGET(PUSH_NUMBER)
+    {
+        uint64_t bits = uint64_t(instruction->b) << 32 | instruction->a;
+        double number;
+        memcpy(&number, &bits, sizeof(number));
+        stack.push_back(Value{number});
+    }
+        DISPATCH();
+    TARGET(PUSH_LITERAL)
+        stack.push_back(Value{tree.number(instruction->a)});
+        DISPATCH();
+    TARGET(PUSH_TRUE)
+        stack.push_back(Value{true});
+        DISPATCH();
+    TARGET(PUSH_FALSE)
+        stack.push_back(Value{false});
+        DISPATCH();
+    TARGET(PUSH_NULL)
+        stack.push_back(Value{nullptr});
+        DISPATCH();
+    TARGET(PUSH_NAN)
+        stack.push_back(noValue);
+        DISPATCH();
+    TARGET(POP)
+        stack.pop_back();
+        DISPATCH();
+
+    TARGET(LOAD)
+    {
+        const Value &value = stack[slots + instruction->a];
+        stack.push_back(isSet(value) ? value : load(*instruction));
+    }
+        DISPATCH();
+    TARGET(STORE)
+        stack[slots + instruction->a] = stack.back();
+        frames.back().scope = nullptr;
+        DISPATCH();
+    TARGET(STORE_POP)
+        stack[slots + instruction->a] = move(stack.back());
+        stack.pop_back();
+        frames.back().scope = nullptr;
+        DISPATCH();
+    TARGET(STORE_GLOBAL)
+        stack[instruction->a] = stack.back();
+        changedBlocks[instruction->a / slotBlockSize] = 1;
+        DISPATCH();
+    TARGET(STORE_GLOBAL_POP)
+        stack[instruction->a] = move(stack.back());
+        stack.pop_back();
+        changedBlocks[instruction->a / slotBlockSize] = 1;
+        DISPATCH();
+
+    TARGET(MAKE_ARRAY)
+    {
+        auto first = stack.end() - instruction->a;
+        auto array = make_shared<vector<Value>>(make_move_iterator(first), make_move_iterator(stack.end()));
+        stack.erase(first, stack.end());
+        stack.push_back(Value{array});
+    }
+        DISPATCH();
+    TARGET(CHECK_INDEX)
+        checkIndex(stack.back());
+        DISPATCH();
+    TARGET(GET_ELEMENT)
+    {
+        Value &index = stack[stack.size() - 2];
+        index = checkElement(stack.back(), index)[int(get<double>(index))];
+        stack.pop_back();
+    }
+        DISPATCH();
+    TARGET(LOAD_ELEMENT)
+    {
+        Value &index = stack.back();
+        checkIndex(index);
+        const Value &variable = stack[slots + instruction->a];
+        const Value &array = isSet(variable) ? variable : load(*instruction);
+        index = checkElement(array, index)[int(get<double>(index))];
+    }
+        DISPATCH();
+    TARGET(SET_ELEMENT)
+    {
+        size_t top = stack.size() - 1;
+        checkElement(stack[top], stack[top - 1])[int(get<double>(stack[top - 1]))] = stack[top - 2];
+        stack.resize(top - 1);
+    }
+        DISPATCH();
+    TARGET(ARRAY_LENGTH)
+        stack.back() = len(stack.back());
+        DISPATCH();
+    TARGET(ARRAY_PUSH)
+    {
+        size_t top = stack.size() - 1;
+        stack[top - 1] = push(stack[top - 1], stack[top]);
+        stack.pop_back();
+    }
+        DISPATCH();
+    TARGET(ARRAY_POP)
+        stack.back() = pop(stack.back());
+        DISPATCH();
+
+    TARGET(CHECK_NOT_BOOL)
+        if (holds_alternative<bool>(stack.back()))
+        {
+            runtimeError("invalid operand type.");
+        }
+        DISPATCH();
+    TARGET(KEEP_IF)
+        // a left operand that is not a bool is left for the operator to reject
+        if (holds_alternative<bool>(stack.back()) && get<bool>(stack.back()) == bool(instruction->b))
+        {
+            pc = code + instruction->a;
+        }
+        DISPATCH();
+#define OPERATOR(name, kind)                                                \
+    TARGET(name)                                                            \
+    {                                                                       \
+        Value &left = stack[stack.size() - 2];                              \
+        checkOperands(kind, left, stack.back());                            \
+        left = apply(kind, left, stack.back());                             \
+        stack.pop_back();                                                   \
+    }                                                                       \
+        DISPATCH();
+    OPERATOR(ADD, TokenKind::PLUS)
+    OPERATOR(SUBTRACT, TokenKind::MINUS)
+    OPERATOR(MULTIPLY, TokenKind::STAR)
+    OPERATOR(DIVIDE, TokenKind::SLASH)
+    OPERATOR(MODULO, TokenKind::PERCENT)
+    OPERATOR(EQUAL, TokenKind::EQ)
+    OPERATOR(NOT_EQUAL, TokenKind::NE)
+    OPERATOR(LESS, TokenKind::LT)
+    OPERATOR(LESS_EQUAL, TokenKind::LE)
+    OPERATOR(GREATER, TokenKind::GT)
+    OPERATOR(GREATER_EQUAL, TokenKind::GE)
+    OPERATOR(AND, TokenKind::AND)
+    OPERATOR(OR, TokenKind::OR)
+    OPERATOR(XOR, TokenKind::XOR)
+#undef OPERATOR
+
+    TARGET(JUMP)
+        pc = code + instruction->a;
+        DISPATCH();
+    TARGET(BRANCH_FALSE)
+    {
+        if (!holds_alternative<bool>(stack.back()))
+        {
+            runtimeError("condition is not a bool.");
+        }
+        bool condition = get<bool>(stack.back());
+        stack.pop_back();
+        if (!condition)
+        {
+            pc = code + instruction->a;
+        }
+    }
+        DISPATCH();
+    TARGET(HALT)
+        return;
+
+    TARGET(PRINT)
+        printValue(stack.back());
+        cout << endl;
+        stack.pop_back();
+        DISPATCH();
+    TARGET(DEFINE)
+    {
+        // the function sees the variables as they are now, but not itself
+        auto function = make_shared<Function>();
+        function->function = instruction->a;
+        if (frames.size() == 1)
+        {
+            function->globals = captureGlobals();
+            changedBlocks[instruction->b / slotBlockSize] = 1;
+        }
+        else
+        {
+            function->scope = scopeOf(frames.size() - 1);
+            frames.back().scope = nullptr;
+        }
+        stack[slots + instruction->b] = Value{function};
+    }
+        DISPATCH();
+    TARGET(BEGIN_STATEMENT)
+        inFunction = false;
+        DISPATCH();
+    TARGET(CHECK_RETURN)
+        if (!inFunction)
+        {
+            runtimeError("unexpected return.");
+        }
+        DISPATCH();
+    TARGET(SET_RETURN)
+        returnValue = move(stack.back());
+        stack.pop_back();
+        DISPATCH();
+    TARGET(RETURN_IF_SET)
+        if (holds_alternative<double>(returnValue) && isnan(get<double>(returnValue)))
+        {
+            DISPATCH();
+        }
+        result = move(returnValue);
+        returnValue = noValue;
+        goto leave;
+    TARGET(END_FUNCTION)
+        inFunction = false;
+        result = Value{nullptr};
+        goto leave;
+
+    TARGET(PREPARE_CALL)
+    {
+        const Value &value = resolve(instruction->a);
+        if (!isFunction(value))
+        {
+            runtimeError("not a function.");
+        }
+        shared_ptr<Function> function = get<shared_ptr<Function>>(value);
+        // CALL takes the code from here
+        if (function->code == nullptr)
+        {
+            function->code = &functionCode(function->function);
+        }
+        if (function->code->parameters.size() != instruction->b)
+        {
+            runtimeError("incorrect argument count.");
+        }
+        stack.push_back(Value{move(function)});
+    }
+        DISPATCH();
+    TARGET(CALL)
+    {
+        size_t base = stack.size() - instruction->a - 1;
+        const Function &function = *get<shared_ptr<Function>>(stack[base]);
+        const Chunk &body = *function.code;
+        // the arguments are already in the slots of their parameters, unless
+        // a name is repeated, when the last one wins
+        size_t first = base + 1;
+        for (size_t i = 0; i < body.parameters.size(); i++)
+        {
+            if (body.parameters[i] != i)
+            {
+                stack[first + body.parameters[i]] = move(stack[first + i]);
+            }
+        }
+        stack.resize(first + body.parameterSlots);
+        stack.resize(first + body.names.size(), unresolved);
+        // a function the caller sees by a parameter's name hides the argument
+        for (uint32_t parameter : body.parameters)
+        {
+            const Value &seen = view(body.names[parameter]);
+            if (isFunction(seen))
+            {
+                stack[first + parameter] = seen;
+            }
+        }
+        frames.push_back(Frame{&body, pc, base, &function, first, ++calls, nullptr});
+        for (uint32_t slot = 0; slot < body.names.size(); slot++)
+        {
+            int symbol = body.names[slot];
+            uint32_t below = bindingOf(symbol);
+            bindings[symbol] = addBinding(Binding{uint32_t(frames.size() - 1), slot, calls, below, unset});
+        }
+        slots = first;
+        code = body.code.data();
+        pc = code;
+        inFunction = true;
+    }
+        DISPATCH();
+
+    TARGET(INVALID_ASSIGNEE)
+        runtimeError("invalid assignee.");
+    TARGET(BAD_ARGUMENT_COUNT)
+        runtimeError("incorrect argument count.");
+    TARGET(UNEXPECTED_NODE)
+    {
+        bool error = false;
+        printErrorStatement(tree.token(instruction->a), error);
+    }
+        DISPATCH();
+    }
+
+leave:
+    // ends the innermost call with result as its value
+    {
+        Frame &frame = frames.back();
+        pc = frame.resume;
+        stack.resize(frame.base);
+        stack.push_back(move(result));
+        frames.pop_back();
+        slots = frames.back().slots;
+        code = frames.back().chunk->code.data();
+    }
+    DISPATCH();
+#undef TARGET
+#undef DISPATCH
+}
+
+// helper function for evaluate print
+void printValue(Value value) 
+{
+    if (holds_alternative<double>(value) && !isnan(get<double>(value)))
+    {
+        cout << get<double>(value);
+    }
+    else if (holds_alternative<bool>(value))
+    {
+        if (get<bool>(value)) {
+            cout << "true";
+        }
+        else {
+            cout << "false";
+        }
+    }
+    else if (value.index() == 2)
+    {
+        cout << "null";
+    }
+    else if (value.index() == 3)
+    {
+        auto vec = *get<shared_ptr<vector<Value>>>(value);
+        cout << "[";
+        for (size_t i = 0; i < vec.size(); i++)
+        {
+            if (i == vec.size() - 1)
+            {
+                printValue(vec[i]);
+            }
+            else
+            {
+                printValue(vec[i]);
+                cout << ", ";
+            }
+        }
+        cout << "]";
+    }
+    else {
+        cout << "cannot print value";
+    }
+}
+
+Value len(Value array) {
+    if (array.index() != 3) {
+        cout << "Runtime error: not an array." << endl;
+        exit(3);
+    }
+    shared_ptr<vector<Value>> arrayPtr = get<shared_ptr<vector<Value>>>(array);
+    // printValue(Value{double((*arrayPtr).size())});
+    return Value{double((*arrayPtr).size())};
+}
+Value push(Value array, Value value) {
+    if (array.index() != 3) {
+        cout << "Runtime error: not an array." << endl;
+        exit(3);
+    }
+    shared_ptr<vector<Value>> arrayPtr = get<shared_ptr<vector<Value>>>(array);
+    (*arrayPtr).push_back(value);
+    return Value{nullptr};
+}
+Value pop(Value array) {
+    if (array.index() != 3) {
+        cout << "Runtime error: not an array." << endl;
+        exit(3);
+    }
+    if (int(get<double>(len(array))) == 0) {
+        cout << "Runtime error: underflow." << endl;
+        exit(3);
+    }
+    shared_ptr<vector<Value>> arrayPtr = get<shared_ptr<vector<Value>>>(array);
+    Value back = (*arrayPtr).back();
+    (*arrayPtr).pop_back();
+    return back;
+}
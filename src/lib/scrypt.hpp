@@ -1,6 +1,8 @@
-#include "statements.hpp"
+#include "bytecode.hpp"
+#include <array>
 #include <memory>
 #include <iostream>
+#include <limits>
 
 class Function;
 
@@ -12,28 +14,170 @@ struct Value: public variant <
     shared_ptr<Function>
 > {};
 
+// std::variant's relational operators do not compile for the nullptr_t
+// alternative, so Values are ordered by alternative first and then by the
+// held value, with null comparing equal to null.
+inline bool operator<(const Value &lhs, const Value &rhs)
+{
+    if (lhs.index() != rhs.index())
+    {
+        return lhs.index() < rhs.index();
+    }
+    switch (lhs.index())
+    {
+    case 0:
+        return get<0>(lhs) < get<0>(rhs);
+    case 1:
+        return get<1>(lhs) < get<1>(rhs);
+    case 3:
+        return get<3>(lhs) < get<3>(rhs);
+    case 4:
+        return get<4>(lhs) < get<4>(rhs);
+    default:
+        return false;
+    }
+}
+inline bool operator>(const Value &lhs, const Value &rhs) { return rhs < lhs; }
+inline bool operator<=(const Value &lhs, const Value &rhs) { return !(rhs < lhs); }
+inline bool operator>=(const Value &lhs, const Value &rhs) { return !(lhs < rhs); }
+
 // using Value = variant<double, bool, nullptr_t, shared_ptr<vector<Value>>, shared_ptr<Function>>;
 
+// Top-level slots in runs of a fixed size, so that definitions made one after
+// another there can share the runs nothing was assigned to in between.
+const size_t slotBlockSize = 32;
+using SlotBlock = array<Value, slotBlockSize>;
+
+// A call's slots as they were when a function was defined in it or in a call
+// it made, and what the call saw below them, for the function to look names
+// up in. What a name turns out to hold is kept, in its slot or in seen.
+struct Scope
+{
+    const Chunk *chunk;                          // the code of the function called, which names the slots
+    vector<Value> values;                        // the slots, some perhaps not yet looked up
+    shared_ptr<Function> function;               // the function called
+    shared_ptr<Scope> below;                     // the caller's, or null for a call from the top level
+    vector<shared_ptr<const SlotBlock>> globals; // the top-level slots, for a call from there
+    unordered_map<int, Value> seen;              // what names without a slot hold
+};
+
 class Function {
     public:
-        FunctDefNode *function;
-        unordered_map<string, Value> functVariables;
+        NodeIndex function; // its definition in the syntax tree
+        // what it sees of the variables as they were when it was defined:
+        // the top-level slots for one defined at the top level, and the
+        // scope of the call for one defined in a call
+        vector<shared_ptr<const SlotBlock>> globals;
+        shared_ptr<Scope> scope;
+        const Chunk *code{nullptr}; // its body's code, once it has been called
 };
 
-Value evaluateAll(Node *node, unordered_map<string, Value> &variables, bool &error, bool &inFunct);
-Value evaluateExpression(Node* root, unordered_map<string, Value> &variables, bool &error, bool &inFunct);
-Value evaluateIfElse(IfElseNode* root, unordered_map<string, Value> &variables, bool &error, bool &inFunct);
-Value evaluateWhile(WhileNode* root, unordered_map<string, Value> &variables, bool &error, bool &inFunct);
-Value evaluatePrint(PrintNode* root, unordered_map<string, Value> &variables, bool &error, bool &inFunct);
-Value evaluateFunctDef(FunctDefNode* root, unordered_map<string, Value> &variables, bool &error, bool &inFunct);
-Value evaluateFunctCall(FunctCallNode* root, unordered_map<string, Value> &variables, bool &error, bool &inFunct);
-Value evaluateReturn(ReturnNode* root, unordered_map<string, Value> &variables, bool &error, bool &inFunct);
-Value evaluateArrayLiteral(ArrayLiteralNode* root, unordered_map<string, Value> &variables, bool &error, bool &inFunct);
-Value evaluateArrayAssign(ArrayAssignNode* root, unordered_map<string, Value> &variables, bool &error, bool &inFunct, bool setValue);
-Value evaluateUtilityFunct(FunctCallNode* root, unordered_map<string, Value> &variables, bool &error, bool &inFunct);
-
 void printValue(Value value);
 Value len(Value array);
 Value push(Value array, Value value);
 Value pop(Value array);
 
+// Runs compiled scrypt code on a stack of values, with a frame of variables
+// for the top level and one for each function call in progress. Calls are
+// made by the dispatch loop itself rather than by recursing into it, and a
+// frame's slots are kept on the stack: the top level's at the bottom, and a
+// call's in place of its arguments, followed by the others, so a call
+// allocates nothing once the stack has grown to the depth it needs.
+//
+// A call sees the variables its function was defined with, its arguments,
+// and over both of them every function its caller sees. Its frame only has
+// slots for the names its function uses, and each is looked up the first time
+// it is read, through the caller's frame and the function, which cannot
+// change while the call is in progress. To find the frames below with a slot
+// for a name without searching each one, every frame adds its slots to a
+// stack of bindings per name when it starts, kept in one pool that the
+// bindings of ended frames go back to, and a frame a name is looked up
+// through without a slot for it gets a binding that keeps what it found, so
+// no frame looks a name up twice. A call so costs the same however many
+// variables there are and however deep it is, and a definition copies only
+// what it has to: at the top level, the blocks of slots assigned to since the
+// last one, and in a call, the call's slots, linked to a copy of each frame
+// below it that is shared for as long as the frame is unchanged.
+class Machine
+{
+public:
+    // Runs a program compiled by compileProgram, exiting on a runtime error.
+    void run(const Chunk &program);
+
+private:
+    struct Frame
+    {
+        const Chunk *chunk;
+        const Instruction *resume; // where the caller goes on after the call
+        size_t base;               // height of the stack below the function called
+        const Function *function;  // the function called, null at the top level
+        size_t slots;              // position of its first slot on the stack
+        uint64_t call;             // which call it is, counting from the top level's 0
+        // its slots as a definition last copied them, until one is assigned to
+        shared_ptr<Scope> scope;
+    };
+
+    // A frame's slot for a name, or what the name holds there if it has none,
+    // in the bindings of the name.
+    struct Binding
+    {
+        uint32_t depth; // of the frame
+        uint32_t slot;  // or noSlot
+        uint64_t call;  // of the frame, as a later one at the same depth makes this stale
+        uint32_t below; // the binding of the name in a frame further down, or noBinding
+        Value value;    // for noSlot
+    };
+    static constexpr uint32_t noBinding = UINT32_MAX;
+
+    // The code of the function defined at def, compiled the first time it is called.
+    const Chunk &functionCode(NodeIndex def);
+
+    // The current frame's slot, looked up if it was not yet.
+    Value &resolve(uint32_t slot);
+    // The value of the variable an instruction names, which has to be set.
+    const Value &load(const Instruction &instruction);
+
+    // What the name symbol holds in the current frame, which is unset if
+    // nothing, filling in the slots for it on the way that were not yet. The
+    // value is only good until the stack changes.
+    const Value &view(int symbol);
+    // The innermost binding of symbol, dropping those of frames that have ended.
+    uint32_t bindingOf(int symbol);
+    // Puts binding in the pool, returning where.
+    uint32_t addBinding(const Binding &binding);
+    // The slot binding is for.
+    Value &slotFor(const Binding &binding);
+    // What function was defined with for the name symbol.
+    const Value &captured(const Function &function, int symbol);
+    // What the name symbol held in scope, filling in what was not yet.
+    const Value &lookup(Scope &scope, int symbol);
+    // What the name symbol holds in the top-level slots globals.
+    const Value &global(const vector<shared_ptr<const SlotBlock>> &globals, int symbol) const;
+    // The slots of the frame at depth and of those below it, for a
+    // definition there to keep.
+    const shared_ptr<Scope> &scopeOf(size_t depth);
+    // The top-level slots for a definition there to keep.
+    const vector<shared_ptr<const SlotBlock>> &captureGlobals();
+
+    vector<Value> stack;
+    vector<Frame> frames;
+    unordered_map<NodeIndex, Chunk> functions;
+    // the top-level slot of each symbol, or noSlot
+    vector<uint32_t> globalSlots;
+    // the top-level slots as the last definition there saw them, and which
+    // blocks of them were assigned to after it
+    vector<shared_ptr<const SlotBlock>> globalBlocks;
+    vector<uint8_t> changedBlocks;
+    // the innermost binding of each symbol, and the pool of bindings, those
+    // of ended frames linked from unbound once dropped
+    vector<uint32_t> bindings;
+    vector<Binding> bound;
+    uint32_t unbound{noBinding};
+    uint64_t calls{0};
+    vector<uint32_t> pending; // bindings whose slots view fills in
+    vector<Scope *> walked;   // scopes lookup fills in
+    // the value of a return not yet taken by the function it is in, NaN if none
+    Value returnValue{numeric_limits<double>::quiet_NaN()};
+    // whether a return is allowed, which a call sets and ending one clears
+    bool inFunction{false};
+};
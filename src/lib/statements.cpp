@@ -1,118 +1,282 @@
 #include "statements.hpp"
+#include "structure.hpp"
 #include <iostream>
 #include <stack>
 #include <limits>
 #include <cmath>
+#include <cstdlib>
+#include <thread>
+#include <algorithm>
 
-void deleteNode(Node *node)
+namespace
 {
-    if (node)
+// The first error a thread parsing one chunk of a parallel parse runs into,
+// kept to be reported once the chunks before it are known to parse cleanly.
+// While deferring, printErrorStatement only sets the error flag, and the
+// parse functions stop their loops on it instead of exiting. A recovering
+// parse defers too, but also collects each error into diagnostics and clears
+// it once it has skipped past the statement it was in.
+struct DeferredError
+{
+    bool deferring{false};
+    bool found{false};
+    Token token;
+    vector<ParseDiagnostic> *diagnostics{nullptr};
+};
+
+thread_local DeferredError deferredError;
+
+// One run of whole top-level statements of a parallel parse.
+struct ParseChunk
+{
+    size_t start;
+    size_t end;  // where the next chunk starts, or the END token
+    size_t stop; // where parsing the chunk's statements got to
+    FlatTree tree;
+    vector<NodeIndex> roots;
+    bool failed{false};
+    Token error;
+};
+
+// After an error in the statement starting at start, moves index to the end
+// of that statement if a recovering parse is collecting errors, and clears
+// the error so parsing can go on with the next one. The statement ends at the
+// first ; outside braces opened in it, or at the } closing such braces unless
+// else follows. In a block, a } closing the block itself ends it instead, and
+// index is left just before it.
+void resynchronize(TokenSpan tokens, int start, int &index, bool &error, bool inBlock)
+{
+    if (!error || deferredError.diagnostics == nullptr)
+    {
+        return;
+    }
+    int depth = 0;
+    for (int i = start; tokens[i].type != END; i++)
     {
-        for (Node *child : node->children)
+        TokenKind kind = tokens[i].kind;
+        bool ends = false;
+        if (kind == TokenKind::LEFT_BRACE)
+        {
+            depth++;
+        }
+        else if (kind == TokenKind::RIGHT_BRACE && depth == 0)
+        {
+            index = inBlock ? i - 1 : i;
+            ends = true;
+        }
+        else if (kind == TokenKind::RIGHT_BRACE)
+        {
+            depth--;
+            ends = depth == 0 && !match(tokens, i + 1, TokenKind::KW_ELSE);
+            index = i;
+        }
+        else if (kind == TokenKind::SEMICOLON && depth == 0)
         {
-            deleteNode(child);
+            ends = true;
+            index = i;
+        }
+        if (ends)
+        {
+            error = false;
+            deferredError.found = false;
+            return;
         }
-        delete node;
     }
+    // an error that runs to the end of the program leaves nothing to go on with
 }
 
-Node *makeNode(const Token &token)
+// Parses the statements from index up to the END token.
+void parseStatements(TokenSpan tokens, int &index, vector<NodeIndex> &roots)
 {
-    Node *node = new Node();
-    node->token = token;
-    return node;
+    while (tokens[index].type != END)
+    {
+        roots.push_back(makeTree(tokens, index));
+        index++;
+    }
 }
 
-WhileNode *makeWhileNode(const Token &token)
-{
-    WhileNode *wNode = new WhileNode();
-    wNode->token = token;
-    return wNode;
-}
-IfElseNode *makeIfElseNode(const Token &token)
-{
-    IfElseNode *iFNode = new IfElseNode();
-    iFNode->token = token;
-    return iFNode;
-}
-PrintNode *makePrintNode(const Token &token)
+// Parses the statements of chunk into the calling thread's tree, holding back
+// any error.
+void parseChunk(TokenSpan tokens, ParseChunk &chunk)
 {
-    PrintNode *pNode = new PrintNode();
-    pNode->token = token;
-    return pNode;
-}
-ArrayLiteralNode *makeArrayLiteralNode(const Token &token)
-{
-    ArrayLiteralNode *aLNode = new ArrayLiteralNode();
-    aLNode->token = token;
-    return aLNode;
+    deferredError = DeferredError{true, false, Token()};
+    int index = int(chunk.start);
+    while (size_t(index) < chunk.end && tokens[index].type != END)
+    {
+        chunk.roots.push_back(makeTree(tokens, index));
+        if (deferredError.found)
+        {
+            break;
+        }
+        index++;
+    }
+    chunk.stop = size_t(index);
+    chunk.failed = deferredError.found;
+    chunk.error = deferredError.token;
+    deferredError.deferring = false;
 }
-// ArrayLookupNode *makeArrayLookupNode(const Token &token)
-// {
-//     ArrayLookupNode *aLNode = new ArrayLookupNode();
-//     aLNode->token = token;
-//     return aLNode;
-// }
-ArrayAssignNode *makeArrayAssignNode(const Token &token)
-{
-    ArrayAssignNode *aANode = new ArrayAssignNode();
-    aANode->token = token;
-    return aANode;
 }
 
-ReturnNode *makeReturnNode(const Token &token)
+// Recursively creates an AST from a list of tokens and returns the position of its root node
+NodeIndex makeTree(TokenSpan tokens, int &index)
 {
-    ReturnNode *rNode = new ReturnNode();
-    rNode->token = token;
-    return rNode;
+    bool error = false;
+    return parseAll(tokens, index, error);
 }
 
-FunctDefNode *makeFunctDefNode(const Token &token)
+vector<NodeIndex> parseProgramRecovering(TokenSpan tokens, vector<ParseDiagnostic> &diagnostics)
 {
-    FunctDefNode *fdNode = new FunctDefNode();
-    fdNode->token = token;
-    return fdNode;
+    deferredError = DeferredError{true, false, Token(), &diagnostics};
+    vector<NodeIndex> roots;
+    int index = 0;
+    while (tokens[index].type != END)
+    {
+        int start = index;
+        bool error = false;
+        NodeIndex root = parseAll(tokens, index, error);
+        if (!error)
+        {
+            roots.push_back(root);
+        }
+        resynchronize(tokens, start, index, error, false);
+        if (error)
+        {
+            break;
+        }
+        index++;
+    }
+    deferredError = DeferredError();
+    return roots;
 }
-FunctCallNode *makeFunctCallNode(const Token &token)
+
+vector<NodeIndex> parseProgram(TokenSpan tokens)
 {
-    FunctCallNode *fcNode = new FunctCallNode();
-    fcNode->functname = token;
-    return fcNode;
+    syntaxTree().setSharing(parseOptions().shareSubtrees);
+    if (tokens.size() >= parallelParseThreshold && sourceStructure().valid)
+    {
+        unsigned threadCount = thread::hardware_concurrency();
+        if (threadCount > 1)
+        {
+            return parseProgramParallel(tokens, threadCount);
+        }
+    }
+    vector<NodeIndex> roots;
+    int index = 0;
+    parseStatements(tokens, index, roots);
+    return roots;
 }
 
-// Recursively creates an AST from a list of tokens and returns the root node
-Node *makeTree(const vector<Token> &tokens, int &index)
+// The tokens are cut into chunks just after statement ends from the structure
+// index, and each chunk is parsed on its own thread into its own tree. A
+// statement can still run on past the end the index gives it, say when its ;
+// is missing, so a chunk only counts if the one before stopped exactly where
+// it starts; from the first chunk that does not, the rest is parsed serially.
+vector<NodeIndex> parseProgramParallel(TokenSpan tokens, unsigned threadCount)
 {
-    bool error = false;
-    return parseAll(tokens, index, error);
+    SourceStructure &structure = sourceStructure();
+    size_t endToken = tokens.size() - 1;
+    vector<ParseChunk> chunks(1);
+    chunks.back().start = 0;
+    for (unsigned i = 1; i < threadCount && structure.valid; i++)
+    {
+        size_t cut = endToken / threadCount * i;
+        auto statementEnd = lower_bound(structure.statementEnds.begin(), structure.statementEnds.end(),
+                                        tokens[cut].offset);
+        if (statementEnd == structure.statementEnds.end())
+        {
+            break;
+        }
+        size_t start = tokenAt(tokens, *statementEnd) + 1;
+        if (start >= endToken)
+        {
+            break;
+        }
+        if (start > chunks.back().start)
+        {
+            chunks.back().end = start;
+            chunks.emplace_back();
+            chunks.back().start = start;
+        }
+    }
+    chunks.back().end = endToken;
+
+    // the first chunk goes into the calling thread's tree and the others into
+    // trees of their own, merged into it after
+    vector<thread> threads;
+    for (size_t i = 1; i < chunks.size(); i++)
+    {
+        threads.emplace_back([tokens, &structure, &chunk = chunks[i]]() {
+            shareStructure(structure);
+            FlatTree &tree = syntaxTree();
+            tree.setSharing(parseOptions().shareSubtrees);
+            tree.reset(tokens);
+            parseChunk(tokens, chunk);
+            chunk.tree = move(tree);
+        });
+    }
+    parseChunk(tokens, chunks[0]);
+    for (thread &worker : threads)
+    {
+        worker.join();
+    }
+
+    FlatTree &tree = syntaxTree();
+    vector<NodeIndex> roots;
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        ParseChunk &chunk = chunks[i];
+        vector<NodeIndex> positions;
+        if (i > 0)
+        {
+            positions = tree.merge(chunk.tree);
+        }
+        for (NodeIndex root : chunk.roots)
+        {
+            roots.push_back(i == 0 || root == noNode ? root : positions[root]);
+        }
+        // every chunk before started where a serial parse would have, so
+        // this is the error it would have stopped at
+        if (chunk.failed)
+        {
+            bool error = false;
+            printErrorStatement(chunk.error, error);
+        }
+        if (chunk.stop != chunk.end)
+        {
+            int index = int(chunk.stop);
+            parseStatements(tokens, index, roots);
+            break;
+        }
+    }
+    return roots;
 }
 
-// Parse all tokens in the given vector and return a pointer to the parsed node
-Node *parseAll(const vector<Token> &tokens, int &index, bool &error)
+// Parse all tokens in the given vector and return the position of the parsed node
+NodeIndex parseAll(TokenSpan tokens, int &index, bool &error)
 {
     if (error)
     {
-        return nullptr;
+        return noNode;
     }
     // check first token for keyword
     // parse each statement type given by the keyword parse them, default to plain expression
-    if(match(tokens, index, "if"))
+    if(match(tokens, index, TokenKind::KW_IF))
     {
         return parseIf(tokens, index, error);
     }
-    else if (match(tokens, index, "while"))
+    else if (match(tokens, index, TokenKind::KW_WHILE))
     {
         return parseWhile(tokens, index, error);
     }
-    else if (match(tokens, index, "print"))
+    else if (match(tokens, index, TokenKind::KW_PRINT))
     {
         return parsePrint(tokens, index, error);
     }
-    else if (match(tokens, index, "return"))
+    else if (match(tokens, index, TokenKind::KW_RETURN))
     {
         return parseReturn(tokens, index, error);
     }
-    else if (match(tokens, index, "def"))
+    else if (match(tokens, index, TokenKind::KW_DEF))
     {
         return parseFunctDef(tokens, index, error);
     }
@@ -123,24 +287,26 @@ Node *parseAll(const vector<Token> &tokens, int &index, bool &error)
 }
 
 // Parses an if statement from a vector of tokens
-IfElseNode *parseIf(const vector<Token> &tokens, int &index, bool &error)
+NodeIndex parseIf(TokenSpan tokens, int &index, bool &error)
 {
     if (error)
     {
-        return nullptr;
+        return noNode;
     }
-    // make a new if/else node
-    IfElseNode *IENode = makeIfElseNode(tokens[index]); // for testing
+    FlatTree &tree = syntaxTree();
+    // the if/else node's children are added as they are parsed
+    const Token &ifToken = tokens[index];
+    size_t ifElse = tree.open();
     // skip token
 
     index ++;
     // if/else node's condition = parse expression 
-    IENode->condition = parseExpression(tokens, index, false, error);
+    tree.push(parseExpression(tokens, index, false, error));
     // check if the conditionn is a boolean
     index++;
 
     // check if there is an open bracket
-    if (match(tokens, index, "{"))
+    if (match(tokens, index, TokenKind::LEFT_BRACE))
     {
         // if so skip token
         index++;
@@ -151,46 +317,54 @@ IfElseNode *parseIf(const vector<Token> &tokens, int &index, bool &error)
         printErrorStatement(tokens[index], error);
     }
     // keep parseAlling until close bracket
-    while (!match(tokens, index, "}"))
+    size_t statementsTrue = tree.open();
+    while (!error && !match(tokens, index, TokenKind::RIGHT_BRACE))
     {
-        // each parseAll will return a node that will be pushed into if/esle node's vector
-        Node *node = parseAll(tokens, index, error);
-        if (node != nullptr)
+        // each parseAll will return a node that will be pushed into if/esle node's block
+        int start = index;
+        NodeIndex node = parseAll(tokens, index, error);
+        if (node != noNode)
         {
-            IENode->statementsTrue.push_back(node);
+            tree.push(node);
         }
+        resynchronize(tokens, start, index, error, true);
         index++;
     }
+    tree.push(tree.close(statementsTrue, NodeKind::BLOCK, ifToken));
     // if false
 
     index ++;
 
-    if (match(tokens, index, "else"))
+    if (match(tokens, index, TokenKind::KW_ELSE))
     {
-        IENode->hasElse = true;
+        // an else block after the then block is what marks the node as having one
+        const Token &elseToken = tokens[index];
+        size_t statementsFalse = tree.open();
         index++;
         // check if there is an open bracket
-        if (match(tokens, index, "{"))
+        if (match(tokens, index, TokenKind::LEFT_BRACE))
         {
             // if so skip token
             index++;
-            while (!match(tokens, index, "}"))
+            while (!error && !match(tokens, index, TokenKind::RIGHT_BRACE))
             {
-                Node *node = parseAll(tokens, index, error);
-                if (node != nullptr)
+                int start = index;
+                NodeIndex node = parseAll(tokens, index, error);
+                if (node != noNode)
                 {
-                    IENode->statementsFalse.push_back(node);
+                    tree.push(node);
                 }
+                resynchronize(tokens, start, index, error, true);
                 index++;
             }
         }
-        else if (match(tokens, index, "if"))
+        else if (match(tokens, index, TokenKind::KW_IF))
         {
             // run code for else if
-            Node *node = parseAll(tokens, index, error);
-            if (node != nullptr)
+            NodeIndex node = parseAll(tokens, index, error);
+            if (node != noNode)
             {
-                IENode->statementsFalse.push_back(node);
+                tree.push(node);
             }
         }
         else
@@ -199,34 +373,33 @@ IfElseNode *parseIf(const vector<Token> &tokens, int &index, bool &error)
             printErrorStatement(tokens[index], error);
         }
         // keep parseAlling until close bracket
+        tree.push(tree.close(statementsFalse, NodeKind::BLOCK, elseToken));
     }
     else
     {
         index--;
-        IENode->hasElse = false;
     }
     // return the if/else node
-    return IENode;
+    return tree.close(ifElse, NodeKind::IF_ELSE, ifToken);
 }
 
 // Parses a while loop from a vector of tokens starting at the given index.
-WhileNode *parseWhile(const vector<Token> &tokens, int &index, bool &error)
+NodeIndex parseWhile(TokenSpan tokens, int &index, bool &error)
 {
     if (error)
     {
-        return nullptr;
+        return noNode;
     }
-    // make a new while node
-    WhileNode *WNode = makeWhileNode(tokens[index]);
+    FlatTree &tree = syntaxTree();
+    const Token &whileToken = tokens[index];
     // skip token
     index++;
-    // make the vector
-    WNode->condition = parseExpression(tokens, index, false, error);
-    // cout << "WNode condition: " << WNode->condition->token.text << endl;
+    // make the condition
+    NodeIndex condition = parseExpression(tokens, index, false, error);
     index++;
 
     // check if there is an open bracket
-    if (match(tokens, index, "{"))
+    if (match(tokens, index, TokenKind::LEFT_BRACE))
     {
         // if so skip token
         index++;
@@ -237,87 +410,87 @@ WhileNode *parseWhile(const vector<Token> &tokens, int &index, bool &error)
         printErrorStatement(tokens[index], error);
     }
     // keep parseAlling until close bracket
-    while (!match(tokens, index, "}"))
+    size_t statements = tree.open();
+    while (!error && !match(tokens, index, TokenKind::RIGHT_BRACE))
     {
-        // each parseAll will return a node that will be pushed into while node's vector
-        Node *node = parseAll(tokens, index, error);
-        if (node != nullptr)
+        // each parseAll will return a node that will be pushed into while node's block
+        int start = index;
+        NodeIndex node = parseAll(tokens, index, error);
+        if (node != noNode)
         {
-            WNode->statements.push_back(node);
+            tree.push(node);
         }
+        resynchronize(tokens, start, index, error, true);
         index++;
     }
+    NodeIndex body = tree.close(statements, NodeKind::BLOCK, whileToken);
     // return the while node
-    return WNode;
+    return tree.add(NodeKind::WHILE, whileToken, {condition, body});
 }
 
 // Parses a print statement from the given tokens
-PrintNode *parsePrint(const vector<Token> &tokens, int &index, bool &error)
+NodeIndex parsePrint(TokenSpan tokens, int &index, bool &error)
 {
     if (error)
     {
-        return nullptr;
+        return noNode;
     }
-    // make a new print node
-    PrintNode *PNode = makePrintNode(tokens[index]);
+    const Token &printToken = tokens[index];
     index++;
-    // if/else node's condition = parse expression
-    PNode->expression = parseExpression(tokens, index, true, error);
+    // print node's expression = parse expression
+    NodeIndex expression = parseExpression(tokens, index, true, error);
     // return the print node
-    return PNode;
+    return syntaxTree().add(NodeKind::PRINT, printToken, {expression});
 }
 
 // Parses a return statement from the given tokens
-ReturnNode *parseReturn(const vector<Token> &tokens, int &index, bool &error)
+NodeIndex parseReturn(TokenSpan tokens, int &index, bool &error)
 {
     if (error)
     {
-        return nullptr;
+        return noNode;
     }
-    // make a new return node
-    ReturnNode *RNode = makeReturnNode(tokens[index]);
+    const Token &returnToken = tokens[index];
     index++;
-    if (match(tokens, index, ";"))
-    {
-        RNode->expression = nullptr;
-    }
-    else 
+    if (match(tokens, index, TokenKind::SEMICOLON))
     {
-        RNode->expression = parseExpression(tokens, index, true, error);
+        // a bare return has no expression at all
+        return syntaxTree().add(NodeKind::RETURN, returnToken);
     }
-    return RNode;
+    NodeIndex expression = parseExpression(tokens, index, true, error);
+    return syntaxTree().add(NodeKind::RETURN, returnToken, {expression});
 }
 
 // Parses a function definition from the given tokens
-FunctDefNode *parseFunctDef(const vector<Token> &tokens, int &index, bool &error)
+NodeIndex parseFunctDef(TokenSpan tokens, int &index, bool &error)
 {
     if (error)
     {
-        return nullptr;
+        return noNode;
     }
-    // make a new function definition node
-    FunctDefNode *FNode = makeFunctDefNode(tokens[index]);
+    FlatTree &tree = syntaxTree();
+    const Token &defToken = tokens[index];
     index++;
-    FNode->functname = tokens[index];
+    const Token &functname = tokens[index];
     index++;
-    if (!match(tokens, index, "("))
+    if (!match(tokens, index, TokenKind::LEFT_PAREN))
     {
         // if not throw error
         printErrorStatement(tokens[index], error);
     }
     index++;
-    while (!match(tokens, index, ")"))
+    size_t params = tree.open();
+    while (!error && !match(tokens, index, TokenKind::RIGHT_PAREN))
     {
         if (tokens[index].type == IDENTIFIER)
         {
-            FNode->vars[tokens[index].text] = numeric_limits<double>::quiet_NaN();
-            FNode->params.push_back(tokens[index].text);
+            tree.push(tree.add(NodeKind::PARAMETER, tokens[index]));
             index++;
-            if (match(tokens, index, ","))
+            if (match(tokens, index, TokenKind::COMMA))
             {
                 index++;
             }
-            else if (!match(tokens, index, ")"))
+            else if (!match(tokens, index, TokenKind::RIGHT_PAREN))
             {
                 printErrorStatement(tokens[index], error);
             }
@@ -328,91 +501,152 @@ FunctDefNode *parseFunctDef(const vector<Token> &tokens, int &index, bool &error
             printErrorStatement(tokens[index], error);
         }
     }
+    NodeIndex paramBlock = tree.close(params, NodeKind::BLOCK, defToken);
     index++;
-    if (!match(tokens, index, "{"))
+    if (!match(tokens, index, TokenKind::LEFT_BRACE))
     {
         // if not throw error
         printErrorStatement(tokens[index], error);
     }
+    NodeIndex body;
+    // a recovering parse is after every error, so it always parses bodies
+    bool lazy = parseOptions().lazyBodies && deferredError.diagnostics == nullptr;
+    size_t closingBrace = lazy ? findPartner(tokens, index) : tokens.size();
+    if (closingBrace < tokens.size())
+    {
+        // only note where the body is, and skip to its end like parsing it would
+        body = tree.add(NodeKind::UNPARSED_BODY, tokens[index]);
+        index = int(closingBrace);
+    }
+    else
+    {
+        body = parseFunctBody(tokens, index, error);
+    }
+    return tree.add(NodeKind::FUNCTION_DEF, functname, {paramBlock, body});
+}
+
+// Parses the statements of a function body, from the { at index up to the }
+// ending it, where index is left
+NodeIndex parseFunctBody(TokenSpan tokens, int &index, bool &error)
+{
+    FlatTree &tree = syntaxTree();
+    const Token &brace = tokens[index];
     index++;
     // keep parseAlling until close bracket
-    while (!match(tokens, index, "}"))
+    size_t statements = tree.open();
+    while (!error && !match(tokens, index, TokenKind::RIGHT_BRACE))
     {
-        // each parseAll will return a node that will be pushed into while node's vector
-        Node *node = parseAll(tokens, index, error);
-        if (node != nullptr)
+        // each parseAll will return a node that will be pushed into the function's block
+        int start = index;
+        NodeIndex node = parseAll(tokens, index, error);
+        if (node != noNode)
         {
-            FNode->statements.push_back(node);
+            tree.push(node);
         }
+        resynchronize(tokens, start, index, error, true);
         index++;
     }
-    return FNode;
+    return tree.close(statements, NodeKind::BLOCK, brace);
+}
+
+// Returns the body block of the function defined at def, parsing it first if
+// it was left unparsed
+NodeIndex functionBody(NodeIndex def)
+{
+    FlatTree &tree = syntaxTree();
+    NodeIndex body = tree.child(def, 1);
+    if (tree[body].kind != NodeKind::UNPARSED_BODY)
+    {
+        return body;
+    }
+    int index = int(tree[body].token);
+    bool error = false;
+    NodeIndex parsed = parseFunctBody(tree.tokens(), index, error);
+    tree.setChild(def, 1, parsed);
+    return parsed;
+}
+
+ParseOptions &parseOptions()
+{
+    static ParseOptions options;
+    return options;
+}
+
+ParseOptions parseOptionsFromEnvironment()
+{
+    auto flag = [](const char *name) {
+        const char *value = getenv(name);
+        return value != nullptr && *value != '\0' && string_view(value) != "0";
+    };
+    ParseOptions options;
+    options.lazyBodies = flag("SCRYPT_LAZY_PARSE");
+    options.shareSubtrees = flag("SCRYPT_SHARE_SUBTREES");
+    return options;
 }
 
 // Parses a function call from the given tokens
-FunctCallNode *parseFunctCall(const vector<Token> &tokens, int &index, bool &error)
+NodeIndex parseFunctCall(TokenSpan tokens, int &index, bool &error)
 {
     if (error)
     {
-        return nullptr;
+        return noNode;
     }
-    // make a new function call node
-    FunctCallNode *FNode = makeFunctCallNode(tokens[index - 1]);
-    FNode->functname = tokens[index - 1];
-    // cout << "make funct call node for " << FNode->functname.text << endl;
+    // the call's arguments are added as they are parsed
+    FlatTree &tree = syntaxTree();
+    const Token &functname = tokens[index - 1];
+    size_t arguments = tree.open();
     index++;
-    if (match(tokens, index, ","))
+    if (match(tokens, index, TokenKind::COMMA))
     {
         error = true;
         printErrorStatement(tokens[index], error);
     }
-    while (!match(tokens, index, ")"))
+    while (!error && !match(tokens, index, TokenKind::RIGHT_PAREN))
     {
-        Node *node = parseExpression(tokens, index, false, error);
-        if (node != nullptr)
+        NodeIndex node = parseExpression(tokens, index, false, error);
+        if (node != noNode)
         {
-            FNode->arguments.push_back(node);
+            tree.push(node);
         }
         index++;
-        if(match(tokens, index, ")")){
+        if(match(tokens, index, TokenKind::RIGHT_PAREN)){
             break;
         }
         index++;
     }
     index++;
-    return FNode;
+    return tree.close(arguments, NodeKind::FUNCTION_CALL, functname);
 }
 
 // Parses an expression from a vector of tokens
-Node *parseExpression(const vector<Token> &tokens, int &index, bool checkSemi, bool &error)
+NodeIndex parseExpression(TokenSpan tokens, int &index, bool checkSemi, bool &error)
 {
     //cout << "index and curr token text: " << index << ", " << tokens[index].text << endl;
     if (error)
     {
-        return nullptr;
+        return noNode;
     }
     int startOfExpression = index;
-    vector<Token> tokensExpression;
     // checks if the current expression is preceded by a "while" or "if" token
     bool braceCheck = false;
     bool bracketCheck = false;
     bool commaCheck = false;
     bool parenCheck = false;
 
-    if (startOfExpression > 0 && (match(tokens, startOfExpression - 1, "while") 
-        || match(tokens, startOfExpression - 1, "if") || match(tokens, startOfExpression - 1, "def")))
+    if (startOfExpression > 0 && (match(tokens, startOfExpression - 1, TokenKind::KW_WHILE) 
+        || match(tokens, startOfExpression - 1, TokenKind::KW_IF) || match(tokens, startOfExpression - 1, TokenKind::KW_DEF)))
     {
         braceCheck = true;
     }
-    if (startOfExpression > 0 && match(tokens, startOfExpression - 1, "["))
+    if (startOfExpression > 0 && match(tokens, startOfExpression - 1, TokenKind::LEFT_BRACKET))
     {
         bracketCheck = true;
     }
-    if (startOfExpression > 0 && match(tokens, startOfExpression - 1, ","))
+    if (startOfExpression > 0 && match(tokens, startOfExpression - 1, TokenKind::COMMA))
     {
         commaCheck = true;
     }
-    if (startOfExpression > 1 && match(tokens, startOfExpression - 1, "(") && tokens[startOfExpression - 2].type == IDENTIFIER) 
+    if (startOfExpression > 1 && match(tokens, startOfExpression - 1, TokenKind::LEFT_PAREN) && tokens[startOfExpression - 2].type == IDENTIFIER) 
     {
         parenCheck = true;
     }
@@ -433,54 +667,35 @@ Node *parseExpression(const vector<Token> &tokens, int &index, bool checkSemi, b
     //     cout << "parenCheck" << endl;
     // }
 
-    int nested = 0;
-    // Iterate through the tokens to build the expression
-    for (size_t x = startOfExpression; x < tokens.size() - 1; x++)
+    // find the expression's last token, jumping through the structural index
+    // instead of walking the tokens; none ends it if it runs to the last one
+    size_t last = tokens.size() - 1;
+    if (braceCheck)
     {
-        Token currToken = tokens[x];
-        Token nextToken = tokens[x + 1];
-        tokensExpression.push_back(currToken);
-        if (braceCheck)
-        {
-            if (nextToken.type == LEFT_BRACE)
-            {
-                index = x;
-                break;
-            }
-        }
-        else if (bracketCheck || commaCheck || parenCheck)
-        {
-            if (currToken.type == LEFT_PAREN || currToken.type == LEFT_BRACKET)
-            {
-                nested++;
-            }
-            if (nested == 0 && (nextToken.type == RIGHT_BRACKET || nextToken.type == COMMA || nextToken.type == RIGHT_PAREN))
-            {
-                index = x;
-                break;
-            }
-            if (nextToken.type == RIGHT_PAREN || nextToken.type == RIGHT_BRACKET)
-            {
-                nested--;
-            }
-        }
-        else if (match(tokens, startOfExpression, "["))
-        {
-            if (currToken.type == SEMICOLON)
-            {
-                index = x;
-                break;
-            }
-        }
-        else
+        last = findStructural(tokens, startOfExpression + 1, tokens.size(), '{') - 1;
+    }
+    else if (bracketCheck || commaCheck || parenCheck)
+    {
+        last = findListEnd(tokens, startOfExpression, tokens.size()) - 1;
+    }
+    else
+    {
+        last = findStructural(tokens, startOfExpression, tokens.size() - 1, ';');
+        // unless it starts with [, an expression also ends before END
+        if (!match(tokens, startOfExpression, TokenKind::LEFT_BRACKET) && last == tokens.size() - 1 && tokens.back().type == END &&
+            size_t(startOfExpression) + 1 < tokens.size())
         {
-            if (nextToken.type == END || currToken.text == ";")
-            {
-                index = x;
-                break;
-            }
+            last = tokens.size() - 2;
         }
     }
+    bool ended = last < tokens.size() - 1;
+    if (ended)
+    {
+        index = last;
+    }
+    // the expression's tokens are viewed in place rather than copied
+    size_t stop = max(ended ? last + 1 : last, size_t(startOfExpression));
+    TokenSpan tokensExpression = tokens.subspan(startOfExpression, stop - startOfExpression);
     
     // cout << "tokensExpression size is: " << tokensExpression.size() << endl;
     // for(size_t i = 0; i < tokensExpression.size(); i++)
@@ -490,19 +705,19 @@ Node *parseExpression(const vector<Token> &tokens, int &index, bool checkSemi, b
     // cout << endl << "Index is: "  << index << endl;
 
     int assignIndex = 0;
-    Node* result = parseAssignment(tokensExpression, assignIndex, error);
+    NodeIndex result = parseAssignment(tokensExpression, assignIndex, error);
 
     // check that expression ends with semicolon if a print/normal expression
     if (!tokensExpression.empty() && checkSemi)
     {
         int checkIndex = tokensExpression.size() - 1;
-        while ((tokensExpression[checkIndex].type == END || tokensExpression[checkIndex].text == "}") && checkIndex > 0)
+        while ((tokensExpression[checkIndex].type == END || tokensExpression[checkIndex].kind == TokenKind::RIGHT_BRACE) && checkIndex > 0)
         {
             checkIndex--;
         }
         // cout << checkIndex << endl;
         // cout << tokensExpression[checkIndex].text << endl;
-        if (tokensExpression[checkIndex].text != ";")
+        if (tokensExpression[checkIndex].kind != TokenKind::SEMICOLON)
         {
             // cout << "Error: Expression must end with semicolon" << endl;
             error = true;
@@ -512,194 +727,77 @@ Node *parseExpression(const vector<Token> &tokens, int &index, bool checkSemi, b
     return result;
 }
 
-// Function to parse assignment expressions
-Node *parseAssignment(const vector<Token> &tokens, int &index, bool &error)
+// Function to parse a whole expression, starting from its loosest operator
+NodeIndex parseAssignment(TokenSpan tokens, int &index, bool &error)
 {
-    //cout << "Value in parse assignment is " << tokens[index].text << endl;
-    if (error)
-    {
-        return nullptr;
-    }
-    Node *left = parseLogicOr(tokens, index, error);
-    if (match(tokens, index, "="))
-    {
-        //cout << "go to equals match" << endl;
-        Node *assignNode = makeNode(tokens[index]);
-        Node *right = parseAssignment(tokens, ++index, error);
-        assignNode->children.push_back(left);
-        assignNode->children.push_back(right);
-        return assignNode;
-    }
-    return left;
+    return parseBinary(tokens, index, ASSIGNMENT, error);
 }
 
-// Function to parse logical expressions
-Node *parseLogicOr(const vector<Token> &tokens, int &index, bool &error)
+// Parses a primary expression and the operators after it that bind at least
+// as tightly as minimum, climbing the shared precedence table: each operator's
+// right operand takes only operators binding more tightly than its own, so
+// same-level chains group to the left. Assignment instead takes everything
+// after it as its right operand.
+NodeIndex parseBinary(TokenSpan tokens, int &index, Precedence minimum, bool &error)
 {
     if (error)
     {
-        return nullptr;
+        return noNode;
     }
-    Node *left = parseLogicXor(tokens, index, error);
-    while (match(tokens, index, "|"))
-    {
-        Token opToken = tokens[index++];
-        Node *right = parseLogicXor(tokens, index, error);
-        Node *opNode = makeNode(opToken);
-        opNode->children.push_back(left);
-        opNode->children.push_back(right);
-        left = opNode;
-    }
-    return left;
-}
-
-// Parses the XOR logic expression from the given tokens
-Node *parseLogicXor(const vector<Token> &tokens, int &index, bool &error)
-{
-    if (error)
+    NodeIndex left = parsePrimary(tokens, index, error);
+    while (!error && index < int(tokens.size()))
     {
-        return nullptr;
-    }
-    Node *left = parseLogicAnd(tokens, index, error);
-    while (match(tokens, index, "^"))
-    {
-        Token opToken = tokens[index++];
-        Node *right = parseLogicAnd(tokens, index, error);
-        Node *opNode = makeNode(opToken);
-        opNode->children.push_back(left);
-        opNode->children.push_back(right);
-        left = opNode;
-    }
-    return left;
-}
-
-// Parses the AND logic expression from the given tokens
-Node *parseLogicAnd(const vector<Token> &tokens, int &index, bool &error)
-{
-    if (error)
-    {
-        return nullptr;
-    }
-    Node *left = parseEquality(tokens, index, error);
-    while (match(tokens, index, "&"))
-    {
-        Token opToken = tokens[index++];
-        Node *right = parseEquality(tokens, index, error);
-        Node *opNode = makeNode(opToken);
-        opNode->children.push_back(left);
-        opNode->children.push_back(right);
-        left = opNode;
-    }
-    return left;
-}
-
-// Function to parse equality expressions
-Node *parseEquality(const vector<Token> &tokens, int &index, bool &error)
-{
-    if (error)
-    {
-        return nullptr;
-    }
-    Node *left = parseComparison(tokens, index, error);
-    while (match(tokens, index, "==") || match(tokens, index, "!="))
-    {
-        Token opToken = tokens[index++];
-        Node *right = parseComparison(tokens, index, error);
-        Node *opNode = makeNode(opToken);
-        opNode->children.push_back(left);
-        opNode->children.push_back(right);
-        left = opNode;
-    }
-    return left;
-}
-
-// Function to parse comparison expressions
-Node *parseComparison(const vector<Token> &tokens, int &index, bool &error)
-{
-    if (error)
-    {
-        return nullptr;
-    }
-    Node *left = parseAddSub(tokens, index, error);
-    while (match(tokens, index, "<") || match(tokens, index, "<=") ||
-           match(tokens, index, ">") || match(tokens, index, ">="))
-    {
-        Token opToken = tokens[index++];
-        Node *right = parseAddSub(tokens, index, error);
-        Node *opNode = makeNode(opToken);
-        opNode->children.push_back(left);
-        opNode->children.push_back(right);
-        left = opNode;
-    }
-    return left;
-}
-
-// Function to parse addition and subtraction expressions
-Node *parseAddSub(const vector<Token> &tokens, int &index, bool &error)
-{
-    if (error)
-    {
-        return nullptr;
-    }
-    Node *left = parseMultDivMod(tokens, index, error);
-    while (match(tokens, index, "+") || match(tokens, index, "-"))
-    {
-        Token opToken = tokens[index++];
-        Node *right = parseMultDivMod(tokens, index, error);
-        Node *opNode = makeNode(opToken);
-        opNode->children.push_back(left);
-        opNode->children.push_back(right);
+        Precedence precedence = binaryPrecedence(tokens[index]);
+        if (precedence < minimum)
+        {
+            break;
+        }
+        const Token &opToken = tokens[index++];
+        bool assignment = precedence == ASSIGNMENT;
+        NodeIndex right = parseBinary(tokens, index, assignment ? ASSIGNMENT : Precedence(precedence + 1), error);
+        NodeIndex opNode = syntaxTree().add(NodeKind::BINARY, opToken, {left, right});
+        if (assignment)
+        {
+            return opNode;
+        }
         left = opNode;
     }
     return left;
 }
 
-// Function to parse multiplication, division, and modulo expressions
-Node *parseMultDivMod(const vector<Token> &tokens, int &index, bool &error)
+// Function to parse primary expressions
+NodeIndex parsePrimary(TokenSpan tokens, int &index, bool &error)
 {
     if (error)
     {
-        return nullptr;
+        return noNode;
     }
-    Node *left = parsePrimary(tokens, index, error);
-    while (match(tokens, index, "*") || match(tokens, index, "/") || match(tokens, index, "%"))
+    FlatTree &tree = syntaxTree();
+    const Token &token = tokens[index++];
+    // cout << "current token text: " << token.text << endl;
+    if (token.type == FLOAT)
     {
-        Token opToken = tokens[index++];
-        Node *right = parsePrimary(tokens, index, error);
-        Node *opNode = makeNode(opToken);
-        opNode->children.push_back(left);
-        opNode->children.push_back(right);
-        left = opNode;
+        return tree.add(NodeKind::NUMBER, token);
     }
-    return left;
-}
-
-// Function to parse primary expressions
-Node *parsePrimary(const vector<Token> &tokens, int &index, bool &error)
-{
-    if (error)
+    else if (token.type == BOOLEAN)
     {
-        return nullptr;
+        return tree.add(NodeKind::BOOLEAN, token);
     }
-    Token token = tokens[index++];
-    // cout << "current token text: " << token.text << endl;
-    if (token.type == FLOAT || token.type == BOOLEAN || token.type == NULLVAL)
+    else if (token.type == NULLVAL)
     {
-        return makeNode(token);
+        return tree.add(NodeKind::NULL_VALUE, token);
     }
     else if (token.type == LEFT_BRACKET)
     {
         // cout << "array literal in primary" << endl;
         // cout << "current token text: " << tokens[index].text << endl;
-        ArrayLiteralNode *array = parseArrayLiteral(tokens, index, error);
+        NodeIndex array = parseArrayLiteral(tokens, index, error);
         //cout << "current token text: " << tokens[index].text << endl;
-        if(match(tokens, index + 1, "["))
+        if(match(tokens, index + 1, TokenKind::LEFT_BRACKET))
         {
             index ++;
             // cout << "parsing lit going into assign" << endl;
-            ArrayAssignNode *arrayAssign = parseArrayAssign(tokens, index, error);
-            arrayAssign->expression = array;
-            return arrayAssign;
+            return parseArrayAssign(tokens, index, array, error);
         }
         else
         {
@@ -709,35 +807,32 @@ Node *parsePrimary(const vector<Token> &tokens, int &index, bool &error)
     else if (token.type == IDENTIFIER)
     {
         //cout << "normal identifier" << endl;
-        if(match(tokens, index, "["))
+        if(match(tokens, index, TokenKind::LEFT_BRACKET))
         {
-            Node *identifier = makeNode(token);
-            ArrayAssignNode *arrayAssign = parseArrayAssign(tokens, index, error);
-            arrayAssign->expression = identifier;
-            return arrayAssign;
+            NodeIndex identifier = tree.add(NodeKind::IDENTIFIER, token);
+            return parseArrayAssign(tokens, index, identifier, error);
         }
-        else if (match(tokens, index, "("))
+        else if (match(tokens, index, TokenKind::LEFT_PAREN))
         {
             // cout << "Parsing function call: " << token.text << endl;
             return parseFunctCall(tokens, index, error);
         }
         else
         {
-            return makeNode(token);
+            return tree.add(NodeKind::IDENTIFIER, token);
         }
     }
     else if (token.type == TokenType::LEFT_PAREN)
     {
-        Node *expression = parseAssignment(tokens, index, error);
-        if (!match(tokens, index, ")"))
+        NodeIndex expression = parseAssignment(tokens, index, error);
+        if (!match(tokens, index, TokenKind::RIGHT_PAREN))
         {
             // Handle missing closing parenthesis error
             if (index < int(tokens.size()) && !error)
             {
                 printErrorStatement(tokens[index], error);
             }
-            deleteNode(expression);
-            return nullptr;
+            return noNode;
         }
         ++index; // Increment index to skip the closing parenthesis
         return expression;
@@ -746,139 +841,67 @@ Node *parsePrimary(const vector<Token> &tokens, int &index, bool &error)
     {
         // Handle unexpected token error
         printErrorStatement(token, error);
-        return nullptr;
+        return noNode;
     }
 }
-ArrayLiteralNode *parseArrayLiteral(const vector<Token> &tokens, int &index, bool &error)
+NodeIndex parseArrayLiteral(TokenSpan tokens, int &index, bool &error)
 {
     //cout << "parsing array literal" << endl;
     if (error)
     {
-        return nullptr;
+        return noNode;
     }
-    ArrayLiteralNode *aLNode = makeArrayLiteralNode(tokens[index - 1]);
+    // the literal's elements are added as they are parsed
+    FlatTree &tree = syntaxTree();
+    const Token &bracket = tokens[index - 1];
+    size_t elements = tree.open();
 
     //cout << "Text of token: " << tokens[index].text << endl;
     // keep parsing until close bracket
-    while (!match(tokens, index, "]"))
+    while (!error && !match(tokens, index, TokenKind::RIGHT_BRACKET))
     {
-        // each parse will return a node that will be pushed into while node's vector
-        Node *node = parseExpression(tokens, index, false, error);
+        // each parse will return a node that will be pushed into the literal's elements
+        NodeIndex node = parseExpression(tokens, index, false, error);
         //cout << "Text of token made it past parse: " << tokens[index].text << endl;
-        if (node != nullptr)
+        if (node != noNode)
         {
-            aLNode->array.push_back(node);
+            tree.push(node);
         }
         index ++;
-        if(match(tokens, index, "]")){
+        if(match(tokens, index, TokenKind::RIGHT_BRACKET)){
             break;
         }
         index ++;
     }
-    // return the while node
-    return aLNode;
+    // return the array literal node
+    return tree.close(elements, NodeKind::ARRAY_LITERAL, bracket);
 }
-ArrayAssignNode *parseArrayAssign(const vector<Token> &tokens, int &index, bool &error)
+NodeIndex parseArrayAssign(TokenSpan tokens, int &index, NodeIndex array, bool &error)
 {
     if (error)
     {
-        return nullptr;
+        return noNode;
     }
-    // set array asign node to the variable before the [
-    ArrayAssignNode *aANode = makeArrayAssignNode(tokens[index - 1]);
+    // the array assign node indexes array, the expression before the [
+    const Token &bracket = tokens[index];
     //move index to the statement in []
     index++;
-    aANode->arrayIndex = parseExpression(tokens, index, false, error);
+    NodeIndex arrayIndex = parseExpression(tokens, index, false, error);
     // skip the ending ]
     index+= 2;
-    return aANode;
+    return syntaxTree().add(NodeKind::ARRAY_INDEX, bracket, {array, arrayIndex});
 }
 
-// Utility function to check if the current token matches the expected token type
-bool match(const vector<Token> &tokens, int index, string expectedType)
+// Utility function to check if the current token is of the expected kind
+bool match(TokenSpan tokens, int index, TokenKind expected)
 {
     if (index >= int(tokens.size()))
     {
         return false;
     }
-    return tokens[index].text == expectedType;
-}
-
-// Throws runtime error for unknown identifier
-bool checkIden(Node *root, unordered_map<string, variant<double, bool>> &variables, bool &error)
-{
-    if (!root)
-    {
-        return true;
-    }
-    if (root->token.text == "=")
-    {
-        bool check = checkIden(root->children[root->children.size() - 1], variables, error);
-        return check;
-    }
-    // If the node is an IDENTIFIER token, check if it exists in the variables map
-    else if (root->token.type == IDENTIFIER)
-    {
-        string identifierText = root->token.text;
-
-        // Check if the identifier exists in the variables unordered_map
-        auto iter = variables.find(identifierText);
-        if (iter == variables.end())
-        {
-            // Handle error: Unknown identifier
-            error = true;
-            cout << "Runtime error: unknown identifier " + identifierText << endl;
-            return false;
-        }
-    }
-    // Recursively check the children nodes
-    for (Node *child : root->children)
-    {
-        if (!checkIden(child, variables, error))
-        {
-            return false;
-        }
-    }
-    return true;
+    return tokens[index].kind == expected;
 }
 
-// Throws error for invalid assignment
-bool checkVar(Node *root, bool &error)
-{
-    if (!root)
-    {
-        return true;
-    }
-    if (root->token.text == "=")
-    {
-        for (int i = int(root->children.size() - 2); i >= 0; i--)
-        {
-            if (error)
-            {
-                break;
-            }
-            if (root->children[i]->token.type != IDENTIFIER)
-            {
-                // invalid assignment error
-                printErrorStatement(root->token, error);
-                return false;
-            }
-        }
-    }
-    // Recursively check the children nodes
-    for (Node *child : root->children)
-    {
-        if (error)
-        {
-            break;
-        }
-        if (!checkVar(child, error))
-        {
-            return false;
-        }
-    }
-    return true;
-}
 // check for parentheses errors
 bool checkParen(vector<Token> &tokens, bool &error)
 {
@@ -891,11 +914,11 @@ bool checkParen(vector<Token> &tokens, bool &error)
 
     for (const Token &token : tokens)
     {
-        if (token.text == "(")
+        if (token.kind == TokenKind::LEFT_PAREN)
         {
             count++;
         }
-        else if (token.text == ")")
+        else if (token.kind == TokenKind::RIGHT_PAREN)
         {
             count--;
 
@@ -919,97 +942,27 @@ bool checkParen(vector<Token> &tokens, bool &error)
 
     return true;
 }
-// Deletes all nodes
-void deleteNodeAll(Node *node)
+void printErrorStatement(const Token &token, bool &error)
 {
-    // for if/else node
-    if (IfElseNode *iENode = dynamic_cast<IfElseNode *>(node))
-    {
-        deleteNodeAll(iENode->condition);
-        for (Node *child : iENode->statementsTrue)
-        {
-            deleteNodeAll(child);
-        }
-        for (Node *child : iENode->statementsFalse)
-        {
-            deleteNodeAll(child);
-        }
-        delete iENode;
-    }
-    // for while node
-    else if (WhileNode *wNode = dynamic_cast<WhileNode *>(node))
-    {
-        deleteNodeAll(wNode->condition);
-        for (Node *child : wNode->statements)
-        {
-            deleteNodeAll(child);
-        }
-        delete wNode;
-    }
-    // for print node
-    else if (PrintNode *pNode = dynamic_cast<PrintNode *>(node))
-    {
-        deleteNodeAll(pNode->expression);
-        delete pNode;
-    }
-    // for return node
-    else if (ReturnNode *rNode = dynamic_cast<ReturnNode *>(node))
-    {
-        if (rNode->expression)
-        {
-            deleteNodeAll(rNode->expression);
-        }
-        delete rNode;
-    }
-    // for function definition
-    else if (FunctDefNode *fNode = dynamic_cast<FunctDefNode *>(node))
-    {
-        for (Node *child : fNode->statements)
-        {
-            deleteNodeAll(child);
-        }
-        delete fNode;
-    }
-    // for function call
-    else if (FunctCallNode *fNode = dynamic_cast<FunctCallNode *>(node))
-    {
-        for (Node *child : fNode->arguments)
-        {
-            deleteNodeAll(child);
-        }
-        delete fNode;
-    }
-    // for array literal node
-    else if(ArrayLiteralNode *aLNode = dynamic_cast<ArrayLiteralNode*>(node))
-    {
-        for (Node *child : aLNode->array)
-        {
-            deleteNodeAll(child);
-        }
-        delete aLNode;
-    }
-    // for array assign node
-    else if(ArrayAssignNode *aANode = dynamic_cast<ArrayAssignNode*>(node))
-    {
-        deleteNodeAll(aANode->expression);
-        deleteNodeAll(aANode->arrayIndex);
-        delete aANode;
-    }
-    else
+    error = true;
+    if (deferredError.deferring)
     {
-        for (Node *child : node->children)
+        // only the first error of a statement counts, as a serial parse stops there
+        if (!deferredError.found)
         {
-            deleteNodeAll(child);
+            deferredError.found = true;
+            deferredError.token = token;
+            if (deferredError.diagnostics != nullptr)
+            {
+                SourceLocation location = locate(token.offset);
+                deferredError.diagnostics->push_back({false, location.line, location.column, string(token.text)});
+            }
         }
-        delete node;
+        return;
     }
-}
-
-void printErrorStatement(const Token &token, bool &error)
-{
-    error = true;
-    cout << "Unexpected token at line " << token.lineNumber
-         << " column " << token.columnNumber << ": "
+    SourceLocation location = locate(token.offset);
+    cout << "Unexpected token at line " << location.line
+         << " column " << location.column << ": "
          << token.text << endl;
     exit(2);
 }
\ No newline at end of file
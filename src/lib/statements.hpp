@@ -1,124 +1,77 @@
-#include "lex.hpp"
+#pragma once
+#include "flat_tree.hpp"
+#include "precedence.hpp"
 #include <unordered_map>
 #include <variant>
 #include <memory>
 
-struct Node
+// Modes the parser can be switched into before parsing.
+struct ParseOptions
 {
-    Token token;
-    vector<Node *> children;
-    virtual ~Node() = default;
+    // Leave each function body as an UNPARSED_BODY node spanning its braces,
+    // to be parsed by functionBody when the function is first called. Startup
+    // then only pays for the functions that run, but a syntax error inside a
+    // body is only reported if the function is called.
+    bool lazyBodies{false};
+    // Store structurally identical subtrees once (see FlatTree::setSharing),
+    // which saves memory on generated programs that repeat expressions and
+    // blocks many times.
+    bool shareSubtrees{false};
 };
 
-struct IfElseNode : public Node
-{
-    Token token;
-    Node* condition;
-    bool hasElse;
-    vector<Node *> statementsTrue;
-    vector<Node *> statementsFalse;
-    virtual ~IfElseNode() = default;
-};
+ParseOptions &parseOptions();
 
-struct WhileNode : public Node
-{
-    Token token;
-    Node* condition;
-    vector<Node *> statements;
-    virtual ~WhileNode() = default;
-};
+// The options set in the environment: SCRYPT_LAZY_PARSE for lazyBodies and
+// SCRYPT_SHARE_SUBTREES for shareSubtrees, each on unless empty or 0.
+ParseOptions parseOptionsFromEnvironment();
 
-struct PrintNode : public Node
-{
-    Token token;
-    Node* expression;
-    virtual ~PrintNode() = default;
-};
+bool checkParen(vector<Token> &tokens, bool &error);
+NodeIndex parseAll(TokenSpan tokens, int &index, bool &error);
+NodeIndex parseIf(TokenSpan tokens, int &index, bool &error);
+NodeIndex parseWhile(TokenSpan tokens, int &index, bool &error);
+NodeIndex parsePrint(TokenSpan tokens, int &index, bool &error);
+NodeIndex parseReturn(TokenSpan tokens, int &index, bool &error);
+NodeIndex parseFunctDef(TokenSpan tokens, int &index, bool &error);
+NodeIndex parseFunctBody(TokenSpan tokens, int &index, bool &error);
+NodeIndex functionBody(NodeIndex def);
+NodeIndex parseFunctCall(TokenSpan tokens, int &index, bool &error);
+NodeIndex parseExpression(TokenSpan tokens, int &index, bool checkSemi, bool &error);
+//Node *parseExpressionInArray(TokenSpan tokens, int &index, bool checkSemi, bool &error);
+NodeIndex parseAssignment(TokenSpan tokens, int &index, bool &error);
+NodeIndex parseBinary(TokenSpan tokens, int &index, Precedence minimum, bool &error);
+NodeIndex parsePrimary(TokenSpan tokens, int &index, bool &error);
 
-struct FunctDefNode : public Node
-{
-    Token token;
-    Token functname;
-    unordered_map<string, variant<double, bool>> vars;
-    vector<string> params;
-    vector<Node *> statements;
-    virtual ~FunctDefNode() = default;
-};
+NodeIndex parseArrayLiteral(TokenSpan tokens, int &index, bool &error);
+NodeIndex parseArrayAssign(TokenSpan tokens, int &index, NodeIndex array, bool &error);
 
-struct FunctCallNode : public Node
-{
-    Token functname;
-    vector<Node *> arguments;
-    virtual ~FunctCallNode() = default;
-};
+bool match(TokenSpan tokens, int index, TokenKind expected);
+NodeIndex makeTree(TokenSpan tokens, int &index);
 
-struct ReturnNode : public Node
-{
-    Token token;
-    Node* expression;
-    virtual ~ReturnNode() = default;
-};
+// Programs with at least this many tokens are parsed in parallel by
+// parseProgram when the machine has more than one core.
+const size_t parallelParseThreshold = 1 << 18;
 
-struct ArrayLiteralNode : public Node
-{
-    Token token;
-    vector<Node*> array;
-    virtual ~ArrayLiteralNode() = default;
-};
+// Parses every statement of tokens into syntaxTree(), which has to have been
+// reset to them, and returns the statements' roots in source order.
+vector<NodeIndex> parseProgram(TokenSpan tokens);
 
-struct ArrayLookupNode : public Node
-{
-    Token token;
-    Node* index;
-    ArrayLiteralNode* refArray;
-    virtual ~ArrayLookupNode() = default;
-};
+// Parses like parseProgram on threadCount threads. The roots and any error
+// message are the same as a serial parse would give.
+vector<NodeIndex> parseProgramParallel(TokenSpan tokens, unsigned threadCount);
 
-struct ArrayAssignNode : public Node
+// An error found in a source without stopping at it.
+struct ParseDiagnostic
 {
-    Token token;
-    Node* expression;
-    Node* arrayIndex;
-    virtual ~ArrayAssignNode() = default;
+    bool lexical; // the source did not lex, rather than not parse
+    int line;
+    int column;
+    string text; // of the unexpected token
 };
 
-Node *makeNode(const Token &token);
-WhileNode *makeWhileNode(const Token &token);
-IfElseNode *makeIfElseNode(const Token &token);
-PrintNode *makePrintNode(const Token &token);
-ReturnNode *makeReturnNode(const Token &token);
-FunctDefNode *makeFunctDefNode(const Token &token);
-FunctCallNode *makeFunctCallNode(const Token &token);
-ArrayLiteralNode *makeArrayLiteralNode(const Token &token);
-//ArrayLookupNode *makeArrayLookupNode(const Token &token);
-ArrayAssignNode *makeArrayAssignNode(const Token &token);
-bool checkIden(Node *root, unordered_map<string, variant<double, bool>> &variables, bool &error);
-bool checkVar(Node *root, bool &error);
-bool checkParen(vector<Token> &tokens, bool &error);
-Node *parseAll(const vector<Token> &tokens, int &index, bool &error);
-IfElseNode *parseIf(const vector<Token> &tokens, int &index, bool &error);
-WhileNode *parseWhile(const vector<Token> &tokens, int &index, bool &error);
-PrintNode *parsePrint(const vector<Token> &tokens, int &index, bool &error);
-ReturnNode *parseReturn(const vector<Token> &tokens, int &index, bool &error);
-FunctDefNode *parseFunctDef(const vector<Token> &tokens, int &index, bool &error);
-FunctCallNode *parseFunctCall(const vector<Token> &tokens, int &index, bool &error);
-Node *parseExpression(const vector<Token> &tokens, int &index, bool checkSemi, bool &error);
-//Node *parseExpressionInArray(const vector<Token> &tokens, int &index, bool checkSemi, bool &error);
-Node *parseAssignment(const std::vector<Token> &tokens, int &index, bool &error);
-Node *parseComparison(const std::vector<Token> &tokens, int &index, bool &error);
-Node *parseLogicAnd(const std::vector<Token> &tokens, int &index, bool &error);
-Node *parseLogicXor(const std::vector<Token> &tokens, int &index, bool &error);
-Node *parseLogicOr(const std::vector<Token> &tokens, int &index, bool &error);
-Node *parseEquality(const std::vector<Token> &tokens, int &index, bool &error);
-Node *parseAddSub(const std::vector<Token> &tokens, int &index, bool &error);
-Node *parseMultDivMod(const std::vector<Token> &tokens, int &index, bool &error);
-Node *parsePrimary(const std::vector<Token> &tokens, int &index, bool &error);
-
-ArrayLiteralNode *parseArrayLiteral(const std::vector<Token> &tokens, int &index, bool &error);
-ArrayAssignNode *parseArrayAssign(const std::vector<Token> &tokens, int &index, bool &error);
-
-bool match(const std::vector<Token> &tokens, int index, string expectedType);
-Node *makeTree(const vector<Token> &tokens, int &index);
-void deleteNode(Node *node);
-void deleteNodeAll(Node *node);
+// Parses like parseProgram, but never prints or exits on an error. Each
+// error is added to diagnostics instead, the statement it is in is skipped up
+// to its ; or }, and parsing goes on, so one pass finds every error. Only the
+// roots of statements without errors are returned. Function bodies are always
+// parsed, lazy or not.
+vector<NodeIndex> parseProgramRecovering(TokenSpan tokens, vector<ParseDiagnostic> &diagnostics);
 void printErrorStatement(const Token &token, bool &error);
\ No newline at end of file
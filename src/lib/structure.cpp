@@ -0,0 +1,329 @@
+#include "structure.hpp"
+#include <algorithm>
+#include <cctype>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+// the index this thread indexes sources into, and the one its lookups read
+thread_local SourceStructure ownStructure;
+thread_local SourceStructure *structure = &ownStructure;
+
+bool isStructural(char c)
+{
+    switch (c)
+    {
+    case '(': case ')': case '[': case ']': case '{': case '}': case ';': case ',':
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Appends the offsets of the structural characters in input to offsets.
+void scanStructural(string_view input, vector<uint32_t> &offsets)
+{
+    const char *begin = input.data();
+    const char *p = begin;
+    const char *end = begin + input.size();
+#ifdef __SSE2__
+    while (end - p >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        // setting bit 0 folds ( onto ), and setting bit 5 folds [ and ] onto
+        // { and }, without mapping anything else there
+        __m128i parens = _mm_cmpeq_epi8(_mm_or_si128(chunk, _mm_set1_epi8(0x01)), _mm_set1_epi8(')'));
+        __m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+        __m128i brackets = _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')),
+                                        _mm_cmpeq_epi8(folded, _mm_set1_epi8('}')));
+        __m128i separators = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(';')),
+                                          _mm_cmpeq_epi8(chunk, _mm_set1_epi8(',')));
+        unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(parens, brackets), separators));
+        while (mask)
+        {
+            offsets.push_back(uint32_t(p - begin) + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+#endif
+    for (; p < end; p++)
+    {
+        if (isStructural(*p))
+        {
+            offsets.push_back(uint32_t(p - begin));
+        }
+    }
+}
+
+// The kind of the token that is the structural character c.
+TokenKind kindOf(char c)
+{
+    switch (c)
+    {
+    case '(':
+        return TokenKind::LEFT_PAREN;
+    case ')':
+        return TokenKind::RIGHT_PAREN;
+    case '[':
+        return TokenKind::LEFT_BRACKET;
+    case ']':
+        return TokenKind::RIGHT_BRACKET;
+    case '{':
+        return TokenKind::LEFT_BRACE;
+    case '}':
+        return TokenKind::RIGHT_BRACE;
+    case ';':
+        return TokenKind::SEMICOLON;
+    default:
+        return TokenKind::COMMA;
+    }
+}
+
+char openerOf(char closer)
+{
+    return closer == ')' ? '(' : closer == ']' ? '[' : '{';
+}
+
+// Whether the word else follows the } that ends just before offset.
+bool followedByElse(string_view input, size_t offset)
+{
+    while (offset < input.size() && string_view(" \t\n\r\v\f").find(input[offset]) != string_view::npos)
+    {
+        offset++;
+    }
+    if (input.substr(offset, 4) != "else")
+    {
+        return false;
+    }
+    offset += 4;
+    return offset == input.size() || !(isalnum(static_cast<unsigned char>(input[offset])) || input[offset] == '_');
+}
+
+// Entry of the first structural character at or after offset.
+size_t entryFrom(uint32_t offset)
+{
+    return lower_bound(structure->offsets.begin(), structure->offsets.end(), offset) - structure->offsets.begin();
+}
+
+// Source offset just past the token before position to, bounding a search.
+uint64_t offsetLimit(TokenSpan tokens, size_t to)
+{
+    return to < tokens.size() ? uint64_t(tokens[to].offset) : uint64_t(tokens.back().offset) + 1;
+}
+}
+
+SourceStructure &sourceStructure()
+{
+    return *structure;
+}
+
+void shareStructure(SourceStructure &index)
+{
+    structure = &index;
+}
+
+void indexStructure(string_view input)
+{
+    structure = &ownStructure;
+    structure->offsets.clear();
+    structure->statementEnds.clear();
+    scanStructural(input, structure->offsets);
+
+    size_t count = structure->offsets.size();
+    structure->characters.resize(count);
+    structure->partners.assign(count, -1);
+    structure->nextSemicolons.resize(count);
+    structure->valid = true;
+    structure->strayParen = -1;
+
+    // match brackets, find statement ends and count parentheses in one sweep
+    vector<int> open;
+    int parenDepth = 0;
+    size_t semicolonPending = 0; // first entry whose next ; is not yet known
+    for (size_t entry = 0; entry < count; entry++)
+    {
+        uint32_t offset = structure->offsets[entry];
+        char c = input[offset];
+        structure->characters[entry] = c;
+        switch (c)
+        {
+        case '(':
+            parenDepth++;
+            // fall through
+        case '[':
+        case '{':
+            open.push_back(int(entry));
+            break;
+
+        case ')':
+            if (--parenDepth < 0 && structure->strayParen < 0)
+            {
+                structure->strayParen = offset;
+            }
+            // fall through
+        case ']':
+        case '}':
+            if (open.empty() || structure->characters[open.back()] != openerOf(c))
+            {
+                structure->valid = false;
+                break;
+            }
+            structure->partners[entry] = open.back();
+            structure->partners[open.back()] = int(entry);
+            open.pop_back();
+            if (c == '}' && open.empty() && !followedByElse(input, offset + 1))
+            {
+                structure->statementEnds.push_back(offset);
+            }
+            break;
+
+        case ';':
+            for (; semicolonPending <= entry; semicolonPending++)
+            {
+                structure->nextSemicolons[semicolonPending] = int(entry);
+            }
+            if (open.empty())
+            {
+                structure->statementEnds.push_back(offset);
+            }
+            break;
+        }
+    }
+    for (; semicolonPending < count; semicolonPending++)
+    {
+        structure->nextSemicolons[semicolonPending] = int(count);
+    }
+    if (!open.empty())
+    {
+        structure->valid = false;
+    }
+    structure->openParens = max(parenDepth, 0);
+}
+
+size_t tokenAt(TokenSpan tokens, uint32_t offset)
+{
+    return lower_bound(tokens.begin(), tokens.end(), offset,
+                       [](const Token &token, uint32_t value) { return token.offset < value; }) -
+           tokens.begin();
+}
+
+size_t findStructural(TokenSpan tokens, size_t from, size_t to, char c)
+{
+    if (from >= to)
+    {
+        return to;
+    }
+    if (!structure->valid)
+    {
+        TokenKind kind = kindOf(c);
+        for (; from < to; from++)
+        {
+            if (tokens[from].kind == kind)
+            {
+                return from;
+            }
+        }
+        return to;
+    }
+
+    size_t count = structure->offsets.size();
+    size_t entry = entryFrom(tokens[from].offset);
+    if (c == ';')
+    {
+        entry = entry < count ? size_t(structure->nextSemicolons[entry]) : count;
+    }
+    else
+    {
+        while (entry < count && structure->characters[entry] != c)
+        {
+            entry++;
+        }
+    }
+    if (entry == count || structure->offsets[entry] >= offsetLimit(tokens, to))
+    {
+        return to;
+    }
+    return tokenAt(tokens, structure->offsets[entry]);
+}
+
+size_t findPartner(TokenSpan tokens, size_t position)
+{
+    if (!structure->valid || position >= tokens.size())
+    {
+        return tokens.size();
+    }
+    size_t entry = entryFrom(tokens[position].offset);
+    if (entry == structure->offsets.size() || structure->offsets[entry] != tokens[position].offset ||
+        structure->partners[entry] < 0)
+    {
+        return tokens.size();
+    }
+    uint32_t offset = structure->offsets[structure->partners[entry]];
+    if (offset > tokens.back().offset)
+    {
+        return tokens.size();
+    }
+    return tokenAt(tokens, offset);
+}
+
+size_t findListEnd(TokenSpan tokens, size_t start, size_t to)
+{
+    if (start + 1 >= to)
+    {
+        return to;
+    }
+    if (!structure->valid)
+    {
+        int nested = 0;
+        for (size_t x = start; x + 1 < to; x++)
+        {
+            TokenType current = tokens[x].type;
+            TokenType next = tokens[x + 1].type;
+            if (current == LEFT_PAREN || current == LEFT_BRACKET)
+            {
+                nested++;
+            }
+            if (nested == 0 && (next == RIGHT_BRACKET || next == COMMA || next == RIGHT_PAREN))
+            {
+                return x + 1;
+            }
+            if (next == RIGHT_PAREN || next == RIGHT_BRACKET)
+            {
+                nested--;
+            }
+        }
+        return to;
+    }
+
+    size_t count = structure->offsets.size();
+    uint64_t limit = offsetLimit(tokens, to);
+    size_t entry = entryFrom(tokens[start].offset);
+    // the first token never ends the list, but a group it opens is skipped
+    if (entry < count && structure->offsets[entry] == tokens[start].offset)
+    {
+        char c = structure->characters[entry];
+        entry = (c == '(' || c == '[') ? size_t(structure->partners[entry]) + 1 : entry + 1;
+    }
+    while (entry < count && structure->offsets[entry] < limit)
+    {
+        char c = structure->characters[entry];
+        if (c == '(' || c == '[')
+        {
+            entry = size_t(structure->partners[entry]) + 1;
+        }
+        else if (c == ',' || c == ')' || c == ']')
+        {
+            return tokenAt(tokens, structure->offsets[entry]);
+        }
+        else
+        {
+            entry++;
+        }
+    }
+    return to;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "lex.hpp"
+
+// Where the brackets, braces, commas and semicolons of a source are, found by
+// one vector scan over the raw text. The language has no strings or comments,
+// so each of those characters is exactly one token at the same offset, and the
+// parser can use the index to jump over a bracketed group or to the end of a
+// statement instead of walking every token in between.
+struct SourceStructure
+{
+    vector<uint32_t> offsets; // of each structural character, in source order
+    vector<char> characters;  // the character at each of offsets
+    // entry of the bracket or brace matching each entry's, -1 for , and ;
+    vector<int> partners;
+    // entry of the first ; at or after each entry, offsets.size() if none
+    vector<int> nextSemicolons;
+    // offsets of the ; or } ending each statement outside any brackets; a }
+    // followed by else does not end its if statement
+    vector<uint32_t> statementEnds;
+    // false if any bracket is unmatched or closed by the wrong kind, in which
+    // case the lookups below walk the tokens instead
+    bool valid{false};
+    // the first ) with no ( before it, or -1, and how many ( are left open;
+    // only counting parentheses, like the parser's parenthesis check
+    int64_t strayParen{-1};
+    int openParens{0};
+};
+
+// Indexes input, which has to be the source the tokens being parsed were
+// lexed from. Each thread has its own index, which the lookups below read.
+void indexStructure(string_view input);
+
+// The index of the source most recently indexed on the calling thread.
+SourceStructure &sourceStructure();
+
+// Makes the calling thread's lookups read index, which another thread made
+// for the source being parsed, until it indexes a source itself.
+void shareStructure(SourceStructure &index);
+
+// Position in tokens of the first token in [from, to) that is the structural
+// character c, or to if there is none. tokens may be any run of the tokens
+// lexed from the indexed source.
+size_t findStructural(TokenSpan tokens, size_t from, size_t to, char c);
+
+// Position in tokens of the first , ) or ] after tokens[start] and before to
+// that is not inside a group of ( or [ opened from start on, or to if there is
+// none.
+size_t findListEnd(TokenSpan tokens, size_t start, size_t to);
+
+// Position in tokens of the bracket or brace matching tokens[position], or
+// tokens.size() if it has none there or the index cannot tell.
+size_t findPartner(TokenSpan tokens, size_t position);
+
+// Position in tokens of the token at a source offset, which has to be there.
+size_t tokenAt(TokenSpan tokens, uint32_t offset);
@@ -1,5 +1,8 @@
 #pragma once
+# include <cmath>
+# include <cstdint>
 # include <string>
+# include <string_view>
 # include <vector>
 
 using namespace std;
@@ -29,10 +32,61 @@ enum TokenType {
     OTHER
 };
 
+// Exactly which punctuator, operator or reserved word a token is, so the
+// parser can dispatch on one small integer instead of comparing text. Names,
+// numbers, END and error tokens are all NONE.
+enum class TokenKind : uint8_t {
+    NONE,
+    LEFT_PAREN, RIGHT_PAREN, LEFT_BRACE, RIGHT_BRACE, LEFT_BRACKET, RIGHT_BRACKET,
+    COMMA, SEMICOLON,
+    ASSIGN, PLUS, MINUS, STAR, SLASH, PERCENT, // =, +, -, *, /, %
+    EQ, NE, LT, LE, GT, GE, // ==, !=, <, <=, >, >=
+    AND, OR, XOR, // &, |, ^
+    KW_IF, KW_ELSE, KW_WHILE, KW_PRINT, KW_RETURN, KW_DEF, KW_TRUE, KW_FALSE, KW_NULL
+};
+
+// A token's text is a view into the source buffer that was passed to
+// readTokens (or a string literal for END and error tokens), so the buffer
+// has to outlive every token lexed from it. Its line and column are looked up
+// from its offset with locate.
 struct Token {
     enum TokenType type{WHITESPACE};
-    string text;
-    int length{0};
-    int lineNumber;
-    int columnNumber;
+    TokenKind kind{TokenKind::NONE}; // always the kind its text spells
+    string_view text;
+    uint32_t offset{0}; // of the token's first character in the source
+    // interned id of an identifier's name (see internSymbol), -1 otherwise
+    int symbol{-1};
+    // value of a FLOAT token, decoded once by the lexer
+    double number{0};
+};
+
+// A run of consecutive tokens, viewing into a vector that has to outlive it.
+// The parser hands sub-expressions around as spans of the lexed tokens
+// instead of copying them into vectors of their own.
+class TokenSpan
+{
+public:
+    TokenSpan(const vector<Token> &tokens) : first(tokens.data()), count(tokens.size()) {}
+    TokenSpan(const Token *first, size_t count) : first(first), count(count) {}
+
+    const Token &operator[](size_t i) const { return first[i]; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const Token &back() const { return first[count - 1]; }
+    const Token *begin() const { return first; }
+    const Token *end() const { return first + count; }
+
+    // The count tokens starting at position from.
+    TokenSpan subspan(size_t from, size_t count) const { return TokenSpan(first + from, count); }
+
+private:
+    const Token *first;
+    size_t count;
 };
+
+// Returns a FLOAT token's value. Literals too large or too small for a double
+// are left NaN by the lexer and go through stod, which reports them as before.
+inline double numberValue(const Token &token)
+{
+    return isnan(token.number) ? stod(string(token.text)) : token.number;
+}
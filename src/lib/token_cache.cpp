@@ -0,0 +1,401 @@
+#include "token_cache.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+const char cacheMagic[4] = {'S', 'T', 'K', 'C'};
+const uint32_t cacheVersion = 2;
+
+// Fixed-size part at the start of every cache entry. The source follows it,
+// so that an entry is only used for exactly the source it was made from, and
+// then the payload, which holds, in order: the identifier names, the texts of
+// spliced tokens, the tokens and then the line index, with all counts and
+// offsets as varints.
+struct CacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+    uint64_t payloadHash;
+    uint32_t nameCount;
+    uint32_t tokenCount;
+    uint32_t splicedCount;
+    uint32_t lineCount;
+    uint32_t skippedCount;
+    uint32_t reserved;
+};
+
+// Flag in a token's first byte, next to its type, for a token whose text is
+// not one run of the source and is stored in the entry instead.
+const uint8_t splicedFlag = 0x80;
+
+// Hashes eight bytes at a time; good enough to name entries and catch damage,
+// though not to tell sources apart, which is why entries keep theirs.
+uint64_t hashBytes(const char *data, size_t size)
+{
+    uint64_t hash = size * 0x9E3779B97F4A7C15ull;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; i++)
+    {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+string cacheDirectory()
+{
+    const char *dir = getenv("SCRYPT_CACHE_DIR");
+    return dir != nullptr ? dir : "";
+}
+
+string entryPath(const string &directory, uint64_t sourceHash)
+{
+    ostringstream path;
+    path << directory << "/" << hex << sourceHash << ".tokens";
+    return path.str();
+}
+
+bool readFile(const string &path, string &contents)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0)
+    {
+        return false;
+    }
+    bool ok = fstat(fd, &info) == 0;
+    if (ok)
+    {
+        contents.resize(size_t(info.st_size));
+        size_t length = 0;
+        ssize_t count = 1;
+        while (length < contents.size() && (count = read(fd, &contents[length], contents.size() - length)) > 0)
+        {
+            length += size_t(count);
+        }
+        ok = length == contents.size();
+    }
+    close(fd);
+    return ok;
+}
+
+void writeVarint(string &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out += char(value | 0x80);
+        value >>= 7;
+    }
+    out += char(value);
+}
+
+// Reads an entry's payload, noting instead of overrunning when it is cut short.
+struct EntryReader
+{
+    const char *p;
+    const char *end;
+    bool ok{true};
+
+    uint64_t varint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (p == end)
+            {
+                ok = false;
+                return 0;
+            }
+            unsigned char byte = static_cast<unsigned char>(*p++);
+            value |= uint64_t(byte & 0x7F) << shift;
+            if (byte < 0x80)
+            {
+                return value;
+            }
+        }
+        ok = false;
+        return 0;
+    }
+
+    string_view bytes(uint64_t size)
+    {
+        if (uint64_t(end - p) < size)
+        {
+            ok = false;
+            return string_view();
+        }
+        string_view text(p, size);
+        p += size;
+        return text;
+    }
+};
+
+// Rebuilds the tokens and line index stored in entry, keeping spliced texts in
+// spliced, or returns false if it does not belong to input or is damaged.
+// Nothing is interned or kept until the whole entry has been checked.
+bool loadEntry(const string &entry, string_view input, uint64_t sourceHash, vector<Token> &tokens,
+               SplicedTexts &spliced)
+{
+    CacheHeader header;
+    if (entry.size() < sizeof(header) || entry.size() - sizeof(header) < input.size())
+    {
+        return false;
+    }
+    memcpy(&header, entry.data(), sizeof(header));
+    const char *source = entry.data() + sizeof(header);
+    EntryReader reader{source + input.size(), entry.data() + entry.size()};
+    if (memcmp(header.magic, cacheMagic, 4) != 0 || header.version != cacheVersion ||
+        header.sourceSize != input.size() || header.sourceHash != sourceHash || header.lineCount == 0 ||
+        memcmp(source, input.data(), input.size()) != 0 ||
+        header.payloadHash != hashBytes(reader.p, size_t(reader.end - reader.p)) ||
+        header.tokenCount > size_t(reader.end - reader.p))
+    {
+        return false;
+    }
+
+    vector<string_view> names(header.nameCount);
+    for (string_view &name : names)
+    {
+        name = reader.bytes(reader.varint());
+    }
+    vector<string_view> splicedTexts(header.splicedCount);
+    for (string_view &text : splicedTexts)
+    {
+        text = reader.bytes(reader.varint());
+    }
+    // the tokens with spliced texts, which point into entry until kept
+    vector<size_t> splicedTokens;
+
+    tokens.resize(header.tokenCount);
+    uint64_t offset = 0;
+    size_t nextSpliced = 0;
+    for (Token &token : tokens)
+    {
+        if (reader.p == reader.end)
+        {
+            return false;
+        }
+        uint8_t typeByte = uint8_t(*reader.p++);
+        token.type = TokenType(typeByte & ~splicedFlag);
+        offset += reader.varint();
+        token.offset = uint32_t(offset);
+        if (token.type >= OTHER || offset > input.size())
+        {
+            return false;
+        }
+        if (token.type == END)
+        {
+            token.text = "END";
+        }
+        else if (typeByte & splicedFlag)
+        {
+            if (nextSpliced == splicedTexts.size())
+            {
+                return false;
+            }
+            splicedTokens.push_back(size_t(&token - tokens.data()));
+            token.text = splicedTexts[nextSpliced++];
+        }
+        else
+        {
+            uint64_t length = reader.varint();
+            if (length > input.size() - offset)
+            {
+                return false;
+            }
+            token.text = string_view(input.data() + offset, length);
+        }
+        token.kind = tokenKind(token.type, token.text);
+        if (token.type == IDENTIFIER)
+        {
+            // the entry's own number for the name until the names are interned
+            uint64_t symbol = reader.varint();
+            if (symbol >= names.size())
+            {
+                return false;
+            }
+            token.symbol = int(symbol);
+        }
+        else if (token.type == FLOAT)
+        {
+            string_view number = reader.bytes(sizeof(double));
+            if (reader.ok)
+            {
+                memcpy(&token.number, number.data(), sizeof(double));
+            }
+        }
+    }
+
+    LineIndex lines;
+    lines.lineStarts.resize(header.lineCount);
+    lines.skipped.resize(header.skippedCount);
+    for (vector<uint32_t> *positions : {&lines.lineStarts, &lines.skipped})
+    {
+        offset = 0;
+        for (uint32_t &position : *positions)
+        {
+            offset += reader.varint();
+            position = uint32_t(offset);
+        }
+    }
+    if (!reader.ok || reader.p != reader.end || lines.lineStarts[0] != 0)
+    {
+        return false;
+    }
+
+    vector<int> symbols(names.size());
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        symbols[i] = internSymbol(names[i]);
+    }
+    for (Token &token : tokens)
+    {
+        if (token.type == IDENTIFIER)
+        {
+            token.symbol = symbols[token.symbol];
+        }
+    }
+    for (size_t token : splicedTokens)
+    {
+        spliced.emplace_back(tokens[token].text);
+        tokens[token].text = spliced.back();
+    }
+    sourceLineIndex() = move(lines);
+    return true;
+}
+
+// Serializes tokens lexed from input, along with the current line index.
+string makeEntry(const vector<Token> &tokens, string_view input, uint64_t sourceHash)
+{
+    string names;
+    string spliced;
+    string records;
+    unordered_map<int, uint32_t> localSymbols;
+    CacheHeader header{};
+    memcpy(header.magic, cacheMagic, 4);
+    header.version = cacheVersion;
+    header.sourceSize = input.size();
+    header.sourceHash = sourceHash;
+
+    uint32_t offset = 0;
+    for (const Token &token : tokens)
+    {
+        bool isSpliced = token.type != END && token.text.data() != input.data() + token.offset;
+        records += char(token.type | (isSpliced ? splicedFlag : 0));
+        writeVarint(records, token.offset - offset);
+        offset = token.offset;
+        if (isSpliced)
+        {
+            writeVarint(spliced, token.text.size());
+            spliced += token.text;
+            header.splicedCount++;
+        }
+        else if (token.type != END)
+        {
+            writeVarint(records, token.text.size());
+        }
+        if (token.type == IDENTIFIER)
+        {
+            auto inserted = localSymbols.emplace(token.symbol, header.nameCount);
+            if (inserted.second)
+            {
+                writeVarint(names, token.text.size());
+                names += token.text;
+                header.nameCount++;
+            }
+            writeVarint(records, inserted.first->second);
+        }
+        else if (token.type == FLOAT)
+        {
+            records.append(reinterpret_cast<const char *>(&token.number), sizeof(double));
+        }
+    }
+    header.tokenCount = uint32_t(tokens.size());
+
+    const LineIndex &lines = sourceLineIndex();
+    header.lineCount = uint32_t(lines.lineStarts.size());
+    header.skippedCount = uint32_t(lines.skipped.size());
+    for (const vector<uint32_t> *positions : {&lines.lineStarts, &lines.skipped})
+    {
+        offset = 0;
+        for (uint32_t position : *positions)
+        {
+            writeVarint(records, position - offset);
+            offset = position;
+        }
+    }
+
+    string payload = names + spliced + records;
+    header.payloadHash = hashBytes(payload.data(), payload.size());
+    string entry(reinterpret_cast<const char *>(&header), sizeof(header));
+    entry += input;
+    return entry + payload;
+}
+}
+
+vector<Token> readTokensCached(string_view input, SplicedTexts &spliced)
+{
+    string directory = cacheDirectory();
+    if (directory.empty() || input.size() < tokenCacheThreshold || input.size() > UINT32_MAX)
+    {
+        return readTokens(input, spliced);
+    }
+
+    uint64_t sourceHash = hashBytes(input.data(), input.size());
+    string path = entryPath(directory, sourceHash);
+    string entry;
+    if (readFile(path, entry))
+    {
+        vector<Token> tokens;
+        if (loadEntry(entry, input, sourceHash, tokens, spliced))
+        {
+            return tokens;
+        }
+    }
+
+    vector<Token> tokens = readTokens(input, spliced);
+    // lexical errors are not cached, so their message is printed on every run
+    if (tokens.empty())
+    {
+        return tokens;
+    }
+
+    // write to a private file first so concurrent runs never see half an
+    // entry, creating it afresh rather than writing through whatever is there
+    error_code error;
+    filesystem::create_directories(directory, error);
+    string temporary = path + "." + to_string(getpid());
+    int out = open(temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW, 0600);
+    if (out >= 0)
+    {
+        entry = makeEntry(tokens, input, sourceHash);
+        size_t length = 0;
+        ssize_t count = 1;
+        while (length < entry.size() && (count = write(out, entry.data() + length, entry.size() - length)) > 0)
+        {
+            length += size_t(count);
+        }
+        if (close(out) != 0 || length != entry.size() || rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            unlink(temporary.c_str());
+        }
+    }
+    return tokens;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "lex.hpp"
+
+// Lexes input like readTokens, but first looks for the tokens an earlier run
+// saved for identical source in the token cache, and saves them there when it
+// has to lex. Entries are named by a hash of the source and keep the source
+// itself, which has to match exactly; one that is stale or damaged is ignored
+// and rewritten. Spliced token texts, whether lexed or loaded, go in spliced.
+//
+// The cache is only used when SCRYPT_CACHE_DIR names the directory for it.
+// Nothing is ever removed from it.
+vector<Token> readTokensCached(string_view input, SplicedTexts &spliced);
+
+// Inputs smaller than this lex faster than a cache entry can be read.
+const size_t tokenCacheThreshold = 16 * 1024;
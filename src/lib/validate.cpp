@@ -0,0 +1,93 @@
+#include "validate.hpp"
+#include "structure.hpp"
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+namespace
+{
+bool readSource(const string &path, string &source)
+{
+    ifstream in(path, ios::binary);
+    if (!in)
+    {
+        return false;
+    }
+    ostringstream contents;
+    contents << in.rdbuf();
+    source = contents.str();
+    return !in.bad();
+}
+}
+
+vector<ParseDiagnostic> validateSource(string_view source)
+{
+    vector<ParseDiagnostic> diagnostics;
+    LexErrors &errors = lexErrors();
+    errors = LexErrors{true, false, 0};
+    SplicedTexts spliced;
+    vector<Token> tokens = readTokens(source, spliced);
+    errors.quiet = false;
+    if (tokens.empty() || tokens.back().text == "error")
+    {
+        SourceLocation location = locate(errors.offset);
+        diagnostics.push_back({true, location.line, location.column, string(source.substr(errors.offset, 1))});
+        return diagnostics;
+    }
+
+    indexStructure(source);
+    FlatTree &tree = syntaxTree();
+    tree.reset(tokens);
+    parseProgramRecovering(tokens, diagnostics);
+    // the tree views tokens, which are about to go
+    tree.reset(TokenSpan(nullptr, 0));
+    return diagnostics;
+}
+
+vector<FileReport> validateFiles(const vector<string> &paths, unsigned threadCount)
+{
+    vector<FileReport> reports(paths.size());
+    atomic<size_t> next{0};
+    auto work = [&]() {
+        for (size_t i = next++; i < paths.size(); i = next++)
+        {
+            string source;
+            reports[i].path = paths[i];
+            reports[i].readable = readSource(paths[i], source);
+            if (reports[i].readable)
+            {
+                reports[i].diagnostics = validateSource(source);
+            }
+        }
+    };
+
+    vector<thread> threads;
+    for (unsigned i = 1; i < threadCount && i < paths.size(); i++)
+    {
+        threads.emplace_back(work);
+    }
+    work();
+    for (thread &worker : threads)
+    {
+        worker.join();
+    }
+    return reports;
+}
+
+string describe(const ParseDiagnostic &diagnostic)
+{
+    ostringstream message;
+    if (diagnostic.lexical)
+    {
+        message << "Syntax error on line " << diagnostic.line << " column " << diagnostic.column << ".";
+    }
+    else
+    {
+        message << "Unexpected token at line " << diagnostic.line << " column " << diagnostic.column << ": "
+                << diagnostic.text;
+    }
+    return message.str();
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "statements.hpp"
+
+// Checks that source lexes and parses, without running it or printing
+// anything, and returns every error found, in source order. A source that
+// does not lex gets just that error, since the lexer stops at it. Only the
+// calling thread's lexer, structure index and tree are used, so separate
+// sources can be checked on separate threads at once.
+vector<ParseDiagnostic> validateSource(string_view source);
+
+// The outcome of checking one file.
+struct FileReport
+{
+    string path;
+    bool readable{false};
+    vector<ParseDiagnostic> diagnostics;
+};
+
+// Checks the files at paths with validateSource on threadCount threads, each
+// taking the next unchecked file until none are left, and returns their
+// reports in the order of paths.
+vector<FileReport> validateFiles(const vector<string> &paths, unsigned threadCount);
+
+// The message scrypt_output or format_output would print for diagnostic.
+string describe(const ParseDiagnostic &diagnostic);
@@ -8,7 +8,7 @@ AST::AST(const vector<Token> &tokens, int &index)
 {
     if (tokens.empty())
     {
-        printErrorTwo(Token{END, "", 0, 1, 1});
+        printErrorTwo(Token{END, TokenKind::NONE, "", 0});
         return;
     }
 
@@ -106,13 +106,13 @@ Node AST::makeTree(const vector<Token> &tokens, int &index)
 }
 
 // Evaluate
-double AST::evaluateAST(std::unordered_map<std::string, double> &variables)
+double AST::evaluateAST(std::unordered_map<int, double> &variables)
 {
     return evaluate(root, variables);
 }
 
 // Evaluates the given AST node and returns the result of the original expression while storing the variables.
-double AST::evaluate(Node node, std::unordered_map<std::string, double> &variables) const
+double AST::evaluate(Node node, std::unordered_map<int, double> &variables) const
 {
     // If the token is an operator, apply the correct operation.
     double result = 0;
@@ -181,7 +181,7 @@ double AST::evaluate(Node node, std::unordered_map<std::string, double> &variabl
                 result = evaluate(node.children[node.children.size() - 1], variables);
                 for (int i = node.children.size() - 2; i >= 0; i--)
                 {
-                    variables[node.children[i].token.text] = result;
+                    variables[node.children[i].token.symbol] = result;
                 }
             }
             else
@@ -195,14 +195,15 @@ double AST::evaluate(Node node, std::unordered_map<std::string, double> &variabl
     // If the node is a float or an identifier, return the value.
     else if (node.token.type == FLOAT)
     {
-        return stod(node.token.text);
+        return numberValue(node.token);
     }
     else if (node.token.type == IDENTIFIER)
     {
         // Check for runtime error
-        if (variables.count(node.token.text) > 0)
+        auto iter = variables.find(node.token.symbol);
+        if (iter != variables.end())
         {
-            return variables.at(node.token.text);
+            return iter->second;
         }
         else
         {
@@ -241,7 +242,7 @@ void AST::printInfix(const Node node) const
 {
     if (node.token.type == FLOAT)
     {
-        double val = stod(node.token.text);
+        double val = numberValue(node.token);
         if (val == static_cast<int>(val))
             cout << static_cast<int>(val);
         else
@@ -280,34 +281,23 @@ void AST::printInfix(const Node node) const
 // Prints an output 2 error message for a given token
 void printErrorTwo(const Token &token)
 {
-    cout << "Unexpected token at line " << token.lineNumber
-         << " column " << token.columnNumber << ": "
+    SourceLocation location = locate(token.offset);
+    cout << "Unexpected token at line " << location.line
+         << " column " << location.column << ": "
          << token.text << endl;
     exit(2);
 }
 
 int main(int argc, const char **argv)
 {
-    string input;
-    string text;
-    vector<Token> tokens;
-
-    while (getline(cin, input))
-    {
-        text += input;
-        if (!cin.eof())
-        {
-            text += '\n';
-        }
-    }
-
-    // lex and then check for lex errors
-    tokens = readTokens(text);
+    // lex straight from the mapped file when a path is given, else from stdin
+    SourceText source(argc > 1 ? argv[1] : nullptr);
+    vector<Token> tokens = readTokens(source.text(), source.spliced());
 
     // set up variables for muti expression parsing
     int index = 0;
     vector<AST> trees;
-    std::unordered_map<std::string, double> variables;
+    std::unordered_map<int, double> variables;
 
     // parse the tokens and put into trees
     while (tokens[index].type != END)
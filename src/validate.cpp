@@ -0,0 +1,34 @@
+#include "lib/validate.hpp"
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+// Checks the syntax of every file named on the command line, on as many
+// threads as the machine has cores, and prints each error found as the
+// file's path followed by the message the interpreter would give for it.
+// Exits with 1 if a file cannot be read or lexed, else with 2 if one does
+// not parse.
+int main(int argc, const char **argv)
+{
+    vector<string> paths(argv + 1, argv + argc);
+    unsigned threadCount = max(thread::hardware_concurrency(), 1u);
+    vector<FileReport> reports = validateFiles(paths, threadCount);
+
+    int status = 0;
+    for (const FileReport &report : reports)
+    {
+        if (!report.readable)
+        {
+            cout << report.path << ": Could not read file." << '\n';
+            status = 1;
+        }
+        for (const ParseDiagnostic &diagnostic : report.diagnostics)
+        {
+            cout << report.path << ": " << describe(diagnostic) << '\n';
+            status = diagnostic.lexical || status == 1 ? 1 : 2;
+        }
+    }
+    return status;
+}
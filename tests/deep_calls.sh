@@ -0,0 +1,57 @@
+#!/bin/bash
+# Checks what scrypt_output prints for programs that recurse 20000 calls deep
+# while defining functions and looking names up through the frames below, and
+# that each finishes within a few seconds, which it does not if a call or a
+# definition costs more the deeper it is made.
+cd "$(dirname "$0")/.." || exit 1
+directory=$(mktemp -d) || exit 1
+trap 'rm -rf "$directory"' EXIT
+
+cases=0
+failures=0
+
+# check name expected program: runs program and compares what it prints
+check() {
+    printf '%s\n' "$3" > "$directory/program"
+    printed=$(timeout 10 ./scrypt_output "$directory/program" 2>&1)
+    status=$?
+    cases=$((cases + 1))
+    if [ "$status" -eq 124 ]; then
+        echo "FAIL: $1 took more than 10 seconds"
+        failures=$((failures + 1))
+    elif [ "$printed" != "$2" ]; then
+        echo "FAIL: $1 printed \"$printed\" instead of \"$2\""
+        failures=$((failures + 1))
+    fi
+}
+
+check "a definition in every call" "0" \
+    "def r(n) { def inner() { return 1; } if n > 0 { return r(n - 1); } return 0; } print r(20000);"
+
+check "a parameter no caller has a slot for" "0" \
+    "def leaf(zz) { return zz; } def r(n) { x = leaf(1); if n > 0 { return r(n - 1); } return 0; } print r(20000);"
+
+check "a function the callers see hides the argument" "7" \
+    "def f() { return 7; } def show(f) { return f; }
+def r(n) { if n > 0 { return r(n - 1); } h = show(1); return h(); }
+print r(20000);"
+
+check "a global read from the deepest definition" "3" \
+    "g = 3;
+def r(n) { def get() { return g; } if n > 0 { return r(n - 1); } return get(); }
+print r(20000);"
+
+# each function keeps x and g as they were when it was defined
+check "definitions kept from every call" "true" \
+    "kept = [];
+g = 1;
+def r(n) { x = n * 2; def get() { return x + g; } push(kept, get); x = 0 - 1; if n > 0 { return r(n - 1); } return 0; }
+r(20000);
+g = 5;
+total = 0;
+i = 0;
+while i < len(kept) { h = kept[i]; total = total + h(); i = i + 1; }
+print total == 400040001;"
+
+echo "deep_calls: $cases programs, $failures failures"
+[ "$failures" -eq 0 ]
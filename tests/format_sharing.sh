@@ -0,0 +1,54 @@
+#!/bin/bash
+# Checks that format_output prints exactly the same, and exits the same way,
+# with SCRYPT_SHARE_SUBTREES set as without it, on programs that repeat
+# expressions and statements, including ones with syntax errors.
+cd "$(dirname "$0")/.." || exit 1
+directory=$(mktemp -d) || exit 1
+trap 'rm -rf "$directory"' EXIT
+
+cases=0
+failures=0
+
+# check name program: formats program both ways and compares what is printed
+check() {
+    printf '%s' "$2" > "$directory/program"
+    ./format_output "$directory/program" > "$directory/plain" 2>&1
+    echo "exit $?" >> "$directory/plain"
+    SCRYPT_SHARE_SUBTREES=1 ./format_output "$directory/program" > "$directory/shared" 2>&1
+    echo "exit $?" >> "$directory/shared"
+    cases=$((cases + 1))
+    if ! cmp -s "$directory/plain" "$directory/shared"; then
+        echo "FAIL: $1 formats differently with SCRYPT_SHARE_SUBTREES:"
+        diff "$directory/plain" "$directory/shared" | head -5
+        failures=$((failures + 1))
+    fi
+}
+
+check "repeated statements" "$(for i in $(seq 1 200); do
+    echo "x = (a + 1) * (a + 1);"
+    echo "if x > 2 { print [1, 2, x]; } else { print [1, 2, x]; }"
+done)"
+
+check "equal values spelled differently" "print 1; print 1.0; print 1.00 + 1; print 1 + 1.0; x = [1, 1.0, 001];"
+
+check "repeated functions" "$(for i in $(seq 1 50); do
+    echo "def f(a, b) { if a < b { return a + b; } while a > 0 { a = a - 1; } return null; }"
+    echo "print f(1, 2) + f(1, 2);"
+done)"
+
+check "repeated blocks in nested ifs" "$(for i in $(seq 1 40); do
+    echo "if true { if false { y = 1; } else { y = 1; } } else if y == 1 { y = 1; } else { print y != null & true | false ^ true; }"
+done)"
+
+check "arrays and indexing" "$(for i in $(seq 1 60); do
+    echo "values = [[1, 2], [1, 2], [3, [1, 2]]]; values[0][1] = values[2][1][0] % 3 / 2;"
+done)"
+
+check "error after repeats" "$(for i in $(seq 1 100); do echo "print (x + 1);"; done; echo "print (x + 1;")"
+
+check "error inside a repeated block" "$(for i in $(seq 1 30); do echo "while x < 3 { x = x + 1; }"; done; echo "while x < 3 { x = x + ; }")"
+
+check "empty" ""
+
+echo "format_sharing: $cases programs, $failures failures"
+[ "$failures" -eq 0 ]
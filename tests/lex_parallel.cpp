@@ -0,0 +1,162 @@
+// Checks that readTokensParallel gives exactly what readTokens gives when it
+// is forced onto several threads, even for inputs far below the size at which
+// readTokens would go parallel itself: the same tokens, the same symbol ids
+// and names, the same lines and columns, and the same error.
+#include "../src/lib/lex.hpp"
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+namespace
+{
+// Everything a lex leaves behind that a caller can see.
+struct LexResult
+{
+    vector<Token> tokens;
+    SplicedTexts spliced; // texts the tokens view into
+    vector<SourceLocation> locations;
+    vector<string> names;
+    bool errorFound;
+    uint32_t errorOffset;
+};
+
+// Lexes input on a thread of its own, so the symbol table and line index it
+// leaves start out empty, on threadCount threads or with readTokens if 0.
+LexResult lex(string_view input, unsigned threadCount)
+{
+    LexResult result;
+    thread([&] {
+        lexErrors().quiet = true;
+        result.tokens = threadCount == 0 ? readTokens(input, result.spliced)
+                                        : readTokensParallel(input, threadCount, result.spliced);
+        for (const Token &token : result.tokens)
+        {
+            result.locations.push_back(locate(token.offset));
+        }
+        for (int symbol = 0; symbol < symbolCount(); symbol++)
+        {
+            result.names.push_back(symbolName(symbol));
+        }
+        result.errorFound = lexErrors().found;
+        result.errorOffset = lexErrors().offset;
+    }).join();
+    return result;
+}
+
+// What differs between the results, or an empty string if nothing.
+string difference(const LexResult &expected, const LexResult &got)
+{
+    if (expected.tokens.size() != got.tokens.size())
+    {
+        return to_string(got.tokens.size()) + " tokens instead of " + to_string(expected.tokens.size());
+    }
+    for (size_t i = 0; i < expected.tokens.size(); i++)
+    {
+        const Token &a = expected.tokens[i];
+        const Token &b = got.tokens[i];
+        if (a.type != b.type || a.kind != b.kind || a.text != b.text || a.offset != b.offset ||
+            a.symbol != b.symbol || a.number != b.number)
+        {
+            return "token " + to_string(i) + " is \"" + string(b.text) + "\" at " + to_string(b.offset) +
+                   " with symbol " + to_string(b.symbol) + " instead of \"" + string(a.text) + "\" at " +
+                   to_string(a.offset) + " with symbol " + to_string(a.symbol);
+        }
+        if (expected.locations[i].line != got.locations[i].line ||
+            expected.locations[i].column != got.locations[i].column)
+        {
+            return "token " + to_string(i) + " is located at line " + to_string(got.locations[i].line) +
+                   " column " + to_string(got.locations[i].column);
+        }
+    }
+    if (expected.names != got.names)
+    {
+        return "interned " + to_string(got.names.size()) + " names instead of " + to_string(expected.names.size()) +
+               " or in another order";
+    }
+    if (expected.errorFound != got.errorFound || expected.errorOffset != got.errorOffset)
+    {
+        return "error " + string(got.errorFound ? "at " + to_string(got.errorOffset) : "not found");
+    }
+    return "";
+}
+
+// A program of about lines lines that reuses a few names everywhere, so that
+// every piece shares names with the others, with \r, \v and \f characters the
+// lexer skips and numbers it has to decode.
+string generateProgram(int lines)
+{
+    const char *names[] = {"alpha", "beta", "gamma", "delta", "counter_with_a_long_name", "x"};
+    string program;
+    for (int i = 0; i < lines; i++)
+    {
+        string name = names[i % 6];
+        string other = names[(i * 7 + 3) % 6];
+        switch (i % 5)
+        {
+        case 0:
+            program += name + " = " + other + " * " + to_string(i) + ".25;\r\n";
+            break;
+        case 1:
+            program += "def f" + to_string(i) + "(" + name + ", " + other + ") {\v return " + name + " <= 1e3; }\n";
+            break;
+        case 2:
+            program += "if " + name + " != null & " + other + " >= -2 { print [" + name + ", true, false]; }\n";
+            break;
+        case 3:
+            program += "\f  while " + other + " < 10 | " + name + " == 0 ^ false {\n" + other + " = " + other +
+                       " + 1; }\n";
+            break;
+        default:
+            program += "print name_" + to_string(i) + " % 3 / 4 - (" + name + ");\n";
+        }
+    }
+    return program;
+}
+}
+
+int main()
+{
+    string program = generateProgram(120);
+    // a character that does not lex two thirds of the way in, then another
+    // that a serial lex never reaches, so only the first may be reported
+    string laterError = program;
+    laterError.insert(laterError.size() * 2 / 3, "fresh_name = 2 $ 3;\n");
+    laterError.insert(laterError.size() * 5 / 6, "other_fresh_name = 4 @ 5;\n");
+
+    struct Case
+    {
+        const char *name;
+        string input;
+    };
+    vector<Case> cases = {
+        {"program", program},
+        {"error in a later piece", laterError},
+        {"error in the first line", "y = 1 # 2;\n" + program},
+        {"error as the last name", program + "print error"},
+        {"error as the second last name", program + "error;"},
+        {"empty", ""},
+        {"no newline", "alpha = beta + 1.5; print alpha;"},
+        {"only newlines", "\n\n\n\n\n"},
+        {"fewer lines than threads", "a = 1;\nb = a;\nprint b;\n"},
+        {"unfinished last line", program + "print alpha +"},
+        {"tokens split by skipped characters", "al\rpha = 1\v2;\n" + program + "print be\fta >\r= 3;\n"},
+    };
+
+    int failures = 0;
+    for (const Case &test : cases)
+    {
+        LexResult expected = lex(test.input, 0);
+        for (unsigned threadCount : {1u, 2u, 3u, 4u, 7u, 16u})
+        {
+            string problem = difference(expected, lex(test.input, threadCount));
+            if (!problem.empty())
+            {
+                cout << "FAIL: " << test.name << " on " << threadCount << " threads: " << problem << endl;
+                failures++;
+            }
+        }
+    }
+    cout << "lex_parallel: " << cases.size() << " inputs, " << failures << " failures" << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,223 @@
+// Checks that parseProgramParallel gives exactly what parseProgram gives when
+// it is forced onto several threads, even for programs far below the size at
+// which parseProgram would go parallel itself: the same trees, and for a
+// program with errors, the same first error and nothing else. Since an error
+// is printed and ends the program, each parse runs in a child process, which
+// prints the trees it parsed, and the test compares what the children print
+// and how they exit.
+#include "../src/lib/statements.hpp"
+#include "../src/lib/structure.hpp"
+#include <iostream>
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace
+{
+// Prints the tree at node, one node per line and children indented under it.
+void printTree(ostream &out, NodeIndex node, int depth)
+{
+    out << string(size_t(depth) * 2, ' ');
+    if (node == noNode)
+    {
+        out << "-\n";
+        return;
+    }
+    const FlatTree &tree = syntaxTree();
+    const FlatNode &flat = tree[node];
+    out << int(flat.kind) << " op " << int(flat.op) << " at " << tree.token(node).offset;
+    switch (flat.kind)
+    {
+    case NodeKind::NUMBER:
+        out << " number " << tree.number(node);
+        break;
+    case NodeKind::BOOLEAN:
+        out << " boolean " << flat.boolean;
+        break;
+    case NodeKind::IDENTIFIER:
+    case NodeKind::FUNCTION_CALL:
+    case NodeKind::FUNCTION_DEF:
+    case NodeKind::PARAMETER:
+        out << " name " << symbolName(flat.symbol);
+        break;
+    default:
+        break;
+    }
+    out << '\n';
+    for (const NodeIndex *child = tree.childrenBegin(node); child != tree.childrenEnd(node); child++)
+    {
+        printTree(out, *child, depth + 1);
+    }
+}
+
+// What a parse of source printed and its exit status, parsing serially if
+// threadCount is 0 and on threadCount threads otherwise.
+string parse(const string &source, unsigned threadCount, ParseOptions options)
+{
+    int output[2];
+    if (pipe(output) != 0)
+    {
+        return "pipe failed";
+    }
+    cout.flush();
+    pid_t child = fork();
+    if (child == 0)
+    {
+        dup2(output[1], STDOUT_FILENO);
+        close(output[0]);
+        close(output[1]);
+        SplicedTexts spliced;
+        vector<Token> tokens = readTokens(string_view(source), spliced);
+        if (tokens.empty() || tokens.back().text == "error")
+        {
+            exit(1);
+        }
+        indexStructure(source);
+        syntaxTree().reset(tokens);
+        parseOptions() = options;
+        vector<NodeIndex> roots;
+        if (threadCount == 0)
+        {
+            roots = parseProgram(tokens);
+        }
+        else
+        {
+            // as parseProgram does before going parallel
+            syntaxTree().setSharing(options.shareSubtrees);
+            roots = parseProgramParallel(tokens, threadCount);
+        }
+        for (NodeIndex root : roots)
+        {
+            printTree(cout, root, 0);
+        }
+        cout.flush();
+        exit(0);
+    }
+    close(output[1]);
+    string printed;
+    char block[4096];
+    ssize_t count;
+    while ((count = read(output[0], block, sizeof(block))) > 0)
+    {
+        printed.append(block, size_t(count));
+    }
+    close(output[0]);
+    int status = 0;
+    waitpid(child, &status, 0);
+    return printed + "exit " + to_string(WIFEXITED(status) ? WEXITSTATUS(status) : -1) + "\n";
+}
+
+// A program of statements statements of every kind, with function bodies,
+// nested blocks and repeated expressions, each on a line of its own.
+string generateProgram(int statements)
+{
+    string program;
+    for (int i = 0; i < statements; i++)
+    {
+        string n = to_string(i);
+        switch (i % 6)
+        {
+        case 0:
+            program += "def f" + n + "(a, b) { if a < b { return [a, b, a + b]; } else { return a * 2; } }\n";
+            break;
+        case 1:
+            program += "x" + n + " = f" + to_string(i - 1) + "(" + n + ", 3)[1] + 2 * (x - 1);\n";
+            break;
+        case 2:
+            program += "while x < 10 & y != null { x = x + 1; print x; }\n";
+            break;
+        case 3:
+            program += "if true { print [1, [2, 3], x]; } else if false { y = 0 - 1.5; } else { y = null; }\n";
+            break;
+        case 4:
+            program += "print (x + 1) * (x + 1) == 4 | x ^ false;\n";
+            break;
+        default:
+            program += "values = [1, 2, 3]; values[0] = values[1] % 2;\n";
+        }
+    }
+    return program;
+}
+
+// source with text put in at the start of the line nearest fraction of the way in.
+string insertLine(string source, double fraction, const string &text)
+{
+    size_t position = source.find('\n', size_t(double(source.size()) * fraction));
+    return source.insert(position == string::npos ? source.size() : position + 1, text);
+}
+}
+
+int main()
+{
+    string program = generateProgram(240);
+
+    struct Case
+    {
+        const char *name;
+        string source;
+        bool valid; // whether a serial parse takes it, so a typo cannot turn every case into the same error
+    };
+    vector<Case> cases = {
+        {"program", program, true},
+        {"error in a later chunk", insertLine(program, 0.8, "x = 1 + ;\n"), false},
+        {"two errors in later chunks", insertLine(insertLine(program, 0.9, "print ];\n"), 0.6, "y = (1;\n"), false},
+        {"error in the first chunk", insertLine(program, 0.1, "if x { print 1 }\n"), false},
+        {"error in a function body", insertLine(program, 0.7, "def broken(a) { return a + ; }\n"), false},
+        // the parser takes this statement up to the next one's ;, past where
+        // the structure index ends it
+        {"statement without its ;", insertLine(program, 0.5, "x = 1\n"), true},
+        {"one statement", "print 1;\n", true},
+        {"empty", "", true},
+    };
+    ParseOptions shared;
+    shared.shareSubtrees = true;
+    ParseOptions lazy;
+    lazy.lazyBodies = true;
+    struct Mode
+    {
+        const char *name;
+        ParseOptions options;
+    };
+    vector<Mode> modes = {{"default", ParseOptions()}, {"SCRYPT_SHARE_SUBTREES", shared}, {"SCRYPT_LAZY_PARSE", lazy}};
+
+    int failures = 0;
+    for (const Case &test : cases)
+    {
+        for (const Mode &mode : modes)
+        {
+            string expected = parse(test.source, 0, mode.options);
+            bool parsed = expected.size() >= 7 && expected.compare(expected.size() - 7, 7, "exit 0\n") == 0;
+            // a lazy parse does not look inside function bodies
+            bool valid = test.valid || (mode.options.lazyBodies && string(test.name) == "error in a function body");
+            if (parsed != valid)
+            {
+                cout << "FAIL: " << test.name << " with " << mode.name << " " << (parsed ? "parsed" : "did not parse")
+                     << " serially" << endl;
+                failures++;
+            }
+            for (unsigned threadCount : {2u, 3u, 4u, 8u})
+            {
+                string got = parse(test.source, threadCount, mode.options);
+                if (got != expected)
+                {
+                    // the first line that differs
+                    istringstream expectedLines(expected);
+                    istringstream gotLines(got);
+                    string expectedLine;
+                    string gotLine;
+                    while (getline(expectedLines, expectedLine) && getline(gotLines, gotLine) &&
+                           expectedLine == gotLine)
+                    {
+                    }
+                    cout << "FAIL: " << test.name << " with " << mode.name << " on " << threadCount
+                         << " threads printed \"" << gotLine << "\" instead of \"" << expectedLine << "\"" << endl;
+                    failures++;
+                }
+            }
+        }
+    }
+    cout << "parse_parallel: " << cases.size() << " programs, " << failures << " failures" << endl;
+    return failures == 0 ? 0 : 1;
+}